@@ -85,6 +85,22 @@ ffi_status ffi_prep_cif_machdep_var(ffi_cif *cif,
 	 unsigned int nfixedargs, unsigned int ntotalargs);
 
 
+/* The static trampoline page is only assembled for LP64 x86-64.  */
+#if FFI_EXEC_STATIC_TRAMP && !(defined (__x86_64__) && !defined (__ILP32__))
+#undef FFI_EXEC_STATIC_TRAMP
+#define FFI_EXEC_STATIC_TRAMP 0
+#endif
+
+/* Allocate memory for generated code, as ffi_closure_alloc does where
+   closures use trampolines of their own.  */
+#if FFI_EXEC_STATIC_TRAMP
+void *ffi_code_alloc (size_t size, void **code) FFI_HIDDEN;
+void ffi_code_free (void *ptr) FFI_HIDDEN;
+#else
+#define ffi_code_alloc ffi_closure_alloc
+#define ffi_code_free ffi_closure_free
+#endif
+
 #if HAVE_LONG_DOUBLE_VARIANT
 /* Used to adjust size/alignment of ffi types.  */
 void ffi_prep_types (ffi_abi abi);
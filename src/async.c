@@ -0,0 +1,277 @@
+/* -----------------------------------------------------------------------
+   async.c - Copyright (c) 2026  The libffi authors
+
+   Calls run on a pool of worker threads.
+
+   Permission is hereby granted, free of charge, to any person obtaining
+   a copy of this software and associated documentation files (the
+   ``Software''), to deal in the Software without restriction, including
+   without limitation the rights to use, copy, modify, merge, publish,
+   distribute, sublicense, and/or sell copies of the Software, and to
+   permit persons to whom the Software is furnished to do so, subject to
+   the following conditions:
+
+   The above copyright notice and this permission notice shall be included
+   in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED ``AS IS'', WITHOUT WARRANTY OF ANY KIND,
+   EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+   MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+   NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+   HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+   WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+   DEALINGS IN THE SOFTWARE.
+   ----------------------------------------------------------------------- */
+
+#include <ffi.h>
+#include <ffi_common.h>
+
+#if FFI_ASYNC_CALLS
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* A queued call.  The arguments follow, packed in the layout given by
+   ffi_get_packed_layout, so that ffi_call_packed can use them.  */
+
+struct ffi_async_job
+{
+  struct ffi_async_job *next;
+  ffi_cif *cif;
+  void (*fn)(void);
+  void *rvalue;
+  void *user_data;
+};
+
+#define JOB_HEADER	FFI_ALIGN (sizeof (struct ffi_async_job), 16)
+
+/* Completed calls are reported through a ring that the workers write
+   without taking a lock.  A worker claims the next position POS, fills
+   in the slot and then sets its sequence number to POS + 1, which tells
+   the reader the slot is ready.  The reader sets it to POS + CAPACITY
+   once it has taken the slot.  At most CAPACITY calls are outstanding,
+   so a worker never finds its slot still in use.  */
+
+struct ffi_async_slot
+{
+  size_t seq;
+  void *user_data;
+};
+
+struct ffi_async_queue
+{
+  pthread_mutex_t lock;
+  pthread_cond_t work;		/* A job was queued, or the pool stops.  */
+  pthread_cond_t done;		/* A call completed with a waiter.  */
+  struct ffi_async_job *head, **tail;
+  int stop;
+
+  size_t mask;			/* Capacity of the ring, less one.  */
+  size_t pending;		/* Calls queued and not yet reported.  */
+  size_t ring_tail;		/* Next position for a worker.  */
+  size_t ring_head;		/* Next position for the reader.  */
+  unsigned waiters;
+  struct ffi_async_slot *ring;
+
+  unsigned int nthreads;
+  pthread_t threads[];
+};
+
+static void
+async_complete (ffi_async_queue *q, void *user_data)
+{
+  size_t pos = __atomic_fetch_add (&q->ring_tail, 1, __ATOMIC_RELAXED);
+  struct ffi_async_slot *slot = &q->ring[pos & q->mask];
+
+  slot->user_data = user_data;
+  __atomic_store_n (&slot->seq, pos + 1, __ATOMIC_SEQ_CST);
+
+  /* Pairs with the increment of waiters in ffi_async_wait: either the
+     waiter sees the slot, or we see the waiter.  */
+  if (__atomic_load_n (&q->waiters, __ATOMIC_SEQ_CST))
+    {
+      pthread_mutex_lock (&q->lock);
+      pthread_cond_broadcast (&q->done);
+      pthread_mutex_unlock (&q->lock);
+    }
+}
+
+static void *
+async_worker (void *arg)
+{
+  ffi_async_queue *q = arg;
+  struct ffi_async_job *job;
+
+  pthread_mutex_lock (&q->lock);
+  for (;;)
+    {
+      while (q->head == NULL && !q->stop)
+	pthread_cond_wait (&q->work, &q->lock);
+
+      /* Jobs still queued are run before the pool stops.  */
+      job = q->head;
+      if (job == NULL)
+	break;
+      q->head = job->next;
+      if (q->head == NULL)
+	q->tail = &q->head;
+      pthread_mutex_unlock (&q->lock);
+
+      ffi_call_packed (job->cif, job->fn, job->rvalue,
+		       (char *) job + JOB_HEADER);
+      async_complete (q, job->user_data);
+      free (job);
+
+      pthread_mutex_lock (&q->lock);
+    }
+  pthread_mutex_unlock (&q->lock);
+  return NULL;
+}
+
+static void
+async_stop (ffi_async_queue *q, unsigned int nthreads)
+{
+  unsigned int i;
+
+  pthread_mutex_lock (&q->lock);
+  q->stop = 1;
+  pthread_cond_broadcast (&q->work);
+  pthread_mutex_unlock (&q->lock);
+
+  for (i = 0; i < nthreads; i++)
+    pthread_join (q->threads[i], NULL);
+
+  pthread_cond_destroy (&q->done);
+  pthread_cond_destroy (&q->work);
+  pthread_mutex_destroy (&q->lock);
+  free (q->ring);
+  free (q);
+}
+
+ffi_async_queue *
+ffi_async_queue_alloc (unsigned int nthreads, unsigned int capacity)
+{
+  ffi_async_queue *q;
+  size_t n = 1, i;
+
+  if (nthreads == 0 || capacity == 0)
+    return NULL;
+  while (n < capacity)
+    n <<= 1;
+
+  q = calloc (1, sizeof (*q) + nthreads * sizeof (pthread_t));
+  if (q == NULL)
+    return NULL;
+  q->ring = malloc (n * sizeof (struct ffi_async_slot));
+  if (q->ring == NULL)
+    {
+      free (q);
+      return NULL;
+    }
+  for (i = 0; i < n; i++)
+    q->ring[i].seq = i;
+  q->mask = n - 1;
+  q->tail = &q->head;
+
+  pthread_mutex_init (&q->lock, NULL);
+  pthread_cond_init (&q->work, NULL);
+  pthread_cond_init (&q->done, NULL);
+
+  for (q->nthreads = 0; q->nthreads < nthreads; q->nthreads++)
+    if (pthread_create (&q->threads[q->nthreads], NULL, async_worker, q))
+      {
+	async_stop (q, q->nthreads);
+	return NULL;
+      }
+
+  return q;
+}
+
+void
+ffi_async_queue_free (ffi_async_queue *q)
+{
+  async_stop (q, q->nthreads);
+}
+
+int
+ffi_call_async (ffi_async_queue *q, ffi_cif *cif, void (*fn)(void),
+		void *rvalue, void **avalue, void *user_data)
+{
+  struct ffi_async_job *job;
+  size_t *offsets, size;
+  char *args;
+  unsigned int i;
+
+  if (__atomic_fetch_add (&q->pending, 1, __ATOMIC_ACQUIRE) > q->mask)
+    goto full;
+
+  offsets = alloca (cif->nargs * sizeof (size_t));
+  size = ffi_get_packed_layout (cif, offsets);
+  job = malloc (JOB_HEADER + size);
+  if (job == NULL)
+    goto full;
+
+  /* Take a copy of the arguments, so the caller may reuse its own.  */
+  args = (char *) job + JOB_HEADER;
+  for (i = 0; i < cif->nargs; i++)
+    memcpy (args + offsets[i], avalue[i], cif->arg_types[i]->size);
+
+  job->next = NULL;
+  job->cif = cif;
+  job->fn = fn;
+  job->rvalue = rvalue;
+  job->user_data = user_data;
+
+  pthread_mutex_lock (&q->lock);
+  *q->tail = job;
+  q->tail = &job->next;
+  pthread_cond_signal (&q->work);
+  pthread_mutex_unlock (&q->lock);
+  return 1;
+
+ full:
+  __atomic_fetch_sub (&q->pending, 1, __ATOMIC_RELAXED);
+  return 0;
+}
+
+int
+ffi_async_poll (ffi_async_queue *q, void **user_data)
+{
+  size_t pos = q->ring_head;
+  struct ffi_async_slot *slot = &q->ring[pos & q->mask];
+
+  if (__atomic_load_n (&slot->seq, __ATOMIC_SEQ_CST) != pos + 1)
+    return 0;
+
+  if (user_data != NULL)
+    *user_data = slot->user_data;
+  __atomic_store_n (&slot->seq, pos + q->mask + 1, __ATOMIC_RELEASE);
+  q->ring_head = pos + 1;
+  __atomic_fetch_sub (&q->pending, 1, __ATOMIC_RELEASE);
+  return 1;
+}
+
+int
+ffi_async_wait (ffi_async_queue *q, void **user_data)
+{
+  while (!ffi_async_poll (q, user_data))
+    {
+      size_t pos = q->ring_head;
+
+      if (__atomic_load_n (&q->pending, __ATOMIC_ACQUIRE) == 0)
+	return 0;
+
+      pthread_mutex_lock (&q->lock);
+      __atomic_add_fetch (&q->waiters, 1, __ATOMIC_SEQ_CST);
+      if (__atomic_load_n (&q->ring[pos & q->mask].seq, __ATOMIC_SEQ_CST)
+	  != pos + 1)
+	pthread_cond_wait (&q->done, &q->lock);
+      __atomic_sub_fetch (&q->waiters, 1, __ATOMIC_SEQ_CST);
+      pthread_mutex_unlock (&q->lock);
+    }
+  return 1;
+}
+
+#endif /* FFI_ASYNC_CALLS */
@@ -537,6 +537,16 @@ static int execfd = -1;
 /* The amount of space already allocated from the temporary file.  */
 static size_t execsize = 0;
 
+#ifdef HAVE_MEMFD_CREATE
+/* Whether EXECFD is an anonymous memory file, and the size it has been
+   grown to.  Such a file has no blocks to preallocate, so it is grown
+   in large steps with ftruncate rather than written page by page.  */
+static int execfd_memfd = 0;
+static size_t execfd_capacity = 0;
+
+#define MEMFD_GROWTH (1024 * 1024)
+#endif
+
 /* Open a temporary file name, and immediately unlink it.  */
 static int
 open_temp_exec_file_name (char *name, int flags)
@@ -594,6 +604,24 @@ open_temp_exec_file_dir (const char *dir)
   return open_temp_exec_file_name (tempname, flags);
 }
 
+#ifdef HAVE_MEMFD_CREATE
+/* Open an anonymous memory file, which needs no writable and
+   executable filesystem, and is never visible in one.  */
+static int
+open_temp_exec_file_memfd (const char *name)
+{
+  int fd;
+
+  fd = memfd_create (name, MFD_CLOEXEC);
+  if (fd != -1)
+    {
+      execfd_memfd = 1;
+      execfd_capacity = 0;
+    }
+  return fd;
+}
+#endif
+
 /* Open a temporary file in the directory in the named environment
    variable.  */
 static int
@@ -664,6 +692,9 @@ static struct
   const char *arg;
   int repeat;
 } open_temp_exec_file_opts[] = {
+#ifdef HAVE_MEMFD_CREATE
+  { open_temp_exec_file_memfd, "libffi", 0 },
+#endif
   { open_temp_exec_file_env, "TMPDIR", 0 },
   { open_temp_exec_file_dir, "/tmp", 0 },
   { open_temp_exec_file_dir, "/var/tmp", 0 },
@@ -739,6 +770,22 @@ allocate_space (int fd, off_t offset, off_t len)
   if (!page_size)
     page_size = sysconf(_SC_PAGESIZE);
 
+#ifdef HAVE_MEMFD_CREATE
+  if (execfd_memfd)
+    {
+      size_t end = offset + len;
+
+      if (end > execfd_capacity)
+	{
+	  end = FFI_ALIGN (end, MEMFD_GROWTH);
+	  if (ftruncate (fd, end))
+	    return -1;
+	  execfd_capacity = end;
+	}
+      return 0;
+    }
+#endif
+
   unsigned char buf[page_size];
   memset (buf, 0, page_size);
 
@@ -753,6 +800,17 @@ allocate_space (int fd, off_t offset, off_t len)
   return 0;
 }
 
+/* Drop the space past OFFSET that a failed mapping had allocated.  */
+static void
+truncate_exec_file (off_t offset)
+{
+  if (ftruncate (execfd, offset))
+    return;
+#ifdef HAVE_MEMFD_CREATE
+  execfd_capacity = offset;
+#endif
+}
+
 /* Map in a chunk of memory from the temporary exec file into separate
    locations in the virtual memory address space, one writable and one
    executable.  Returns the address of the writable portion, after
@@ -767,6 +825,9 @@ dlmmap_locked (void *start, size_t length, int prot, int flags, off_t offset)
     {
       open_temp_exec_file_opts_idx = 0;
     retry_open:
+#ifdef HAVE_MEMFD_CREATE
+      execfd_memfd = 0;
+#endif
       execfd = open_temp_exec_file ();
       if (execfd == -1)
 	return MFAIL;
@@ -789,7 +850,7 @@ dlmmap_locked (void *start, size_t length, int prot, int flags, off_t offset)
 	  close (execfd);
 	  goto retry_open;
 	}
-      ftruncate (execfd, offset);
+      truncate_exec_file (offset);
       return MFAIL;
     }
   else if (!offset
@@ -801,7 +862,7 @@ dlmmap_locked (void *start, size_t length, int prot, int flags, off_t offset)
   if (start == MFAIL)
     {
       munmap (ptr, length);
-      ftruncate (execfd, offset);
+      truncate_exec_file (offset);
       return start;
     }
 
@@ -898,11 +959,441 @@ segment_holding_code (mstate m, char* addr)
 
 #endif /* !(defined(X86_WIN32) || defined(X86_WIN64) || defined(__OS2__)) || defined (__CYGWIN__) || defined(__INTERIX) */
 
+/* Where there are threads, closures of up to CACHE_CLASSES *
+   CACHE_GRAIN bytes are not given back once freed, but kept in a
+   cache owned by the thread that allocated them, so that allocating
+   and freeing does not take a global lock.  A closure freed by any
+   other thread is pushed onto its owner's list of remote frees, which
+   the owner takes back when it next runs short.
+
+   Caches exchange closures with a shared pool in batches of
+   CACHE_BATCH, and only go to the lock-protected allocators below
+   when the pool is empty, one batch at a time.  The pool for each
+   size is a stack of batches; batches are only ever pushed one at a
+   time with a compare-and-swap, and popped by taking the whole stack
+   and pushing back all but the first, so that a batch cannot be
+   popped twice.  */
+
+#if FFI_EXEC_STATIC_TRAMP \
+  || (!defined(X86_WIN32) && !defined(X86_WIN64) && !defined(__OS2__) \
+      && defined (__GNUC__) && !FFI_CLOSURE_FREE_CODE)
+# define FFI_CLOSURE_CACHE 1
+#endif
+
+#if FFI_CLOSURE_CACHE
+
+struct closure_cache;
+
+/* Each closure follows a header, which records its executable
+   address and where it goes when it is freed.  */
+struct closure_header
+{
+  void *code;
+  union
+  {
+    /* The cache of the thread that allocated the closure.  */
+    struct closure_cache *owner;
+    /* The next batch in the shared pool, for the first closure of
+       each batch.  */
+    struct closure_header *batch;
+  } u;
+  /* The next free closure, in a cache or a batch.  */
+  struct closure_header *next;
+  /* The size class, or CACHE_CLASSES if the closure is not cached.  */
+  size_t cls;
+};
+
+#define CLOSURE_HEADER \
+  FFI_ALIGN (sizeof (struct closure_header), 2 * sizeof (void *))
+#define CLOSURE_OF(hdr)	((char *) (hdr) + CLOSURE_HEADER)
+#define HEADER_OF(ptr) \
+  ((struct closure_header *) ((char *) (ptr) - CLOSURE_HEADER))
+
+#endif /* FFI_CLOSURE_CACHE */
+
+#if FFI_EXEC_STATIC_TRAMP
+
+/* Closure trampolines come from a page of libffi's own code, which is
+   mapped again from its file just after a page of data, so that
+   neither page is ever writable and executable.  Each trampoline
+   finds its closure at the same offset in the data page, and jumps
+   to the address in the closure's own trampoline.  The closure itself
+   lives in ordinary memory, after a header that records its
+   trampoline.
+
+   The data page starts with the table's header, so the first
+   trampolines are never used.  Each other slot holds the closure for
+   its trampoline, and links the slot into the free list while it is
+   unused.  */
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#define STATIC_TRAMP_PAGE	4096
+#define STATIC_TRAMP_SIZE	16
+#define STATIC_TRAMP_COUNT	(STATIC_TRAMP_PAGE / STATIC_TRAMP_SIZE)
+
+extern char ffi_static_tramp_page[] FFI_HIDDEN;
+
+typedef struct static_tramp_table static_tramp_table;
+typedef struct static_tramp_slot static_tramp_slot;
+
+struct static_tramp_slot
+{
+  void *closure;
+  static_tramp_slot *next;
+};
+
+struct static_tramp_table
+{
+  static_tramp_table *prev;
+  static_tramp_table *next;
+  static_tramp_slot *free_list;
+  unsigned int free_count;
+};
+
+#define STATIC_TRAMP_FIRST \
+  ((sizeof (static_tramp_table) + STATIC_TRAMP_SIZE - 1) / STATIC_TRAMP_SIZE)
+#define STATIC_TRAMP_SLOTS	(STATIC_TRAMP_COUNT - STATIC_TRAMP_FIRST)
+
+static pthread_mutex_t static_tramp_lock = PTHREAD_MUTEX_INITIALIZER;
+static static_tramp_table *static_tramp_tables;
+
+/* -1 until the first closure is allocated, then whether the
+   trampoline page could be found in its file.  */
+static int static_tramp_enabled = -1;
+static int static_tramp_fd = -1;
+static off_t static_tramp_offset;
+
+/* Find the file and offset that the trampoline page is mapped from,
+   and check that the file still holds the same code.  */
+static int
+static_tramp_init (void)
+{
+  uintptr_t addr = (uintptr_t) ffi_static_tramp_page;
+  char *buf = NULL;
+  size_t len = 0;
+  FILE *f;
+
+  if (sysconf (_SC_PAGESIZE) != STATIC_TRAMP_PAGE)
+    return 0;
+
+  f = fopen ("/proc/self/maps", "r");
+  if (f == NULL)
+    return 0;
+  while (getline (&buf, &len, f) >= 0)
+    {
+      unsigned long start, end, offset;
+      char *path, *nl;
+      int pos = 0;
+
+      if (sscanf (buf, "%lx-%lx %*s %lx %*s %*s %n",
+		  &start, &end, &offset, &pos) < 3 || pos == 0)
+	continue;
+      if (addr < start || addr >= end)
+	continue;
+
+      path = buf + pos;
+      nl = strchr (path, '\n');
+      if (nl)
+	*nl = '\0';
+      if (*path == '/')
+	{
+#ifdef O_CLOEXEC
+	  static_tramp_fd = open (path, O_RDONLY | O_CLOEXEC);
+#else
+	  static_tramp_fd = open (path, O_RDONLY);
+#endif
+	  static_tramp_offset = offset + (addr - start);
+	}
+      break;
+    }
+  free (buf);
+  fclose (f);
+
+  if (static_tramp_fd != -1)
+    {
+      char check[STATIC_TRAMP_SIZE];
+
+      if (pread (static_tramp_fd, check, sizeof (check), static_tramp_offset)
+	  == sizeof (check)
+	  && memcmp (check, ffi_static_tramp_page, sizeof (check)) == 0)
+	return 1;
+      close (static_tramp_fd);
+      static_tramp_fd = -1;
+    }
+  return 0;
+}
+
+static static_tramp_table *
+static_tramp_table_alloc (void)
+{
+  static_tramp_table *table;
+  static_tramp_slot *slots;
+  char *data, *code;
+  unsigned int i;
+
+  data = mmap (NULL, 2 * STATIC_TRAMP_PAGE, PROT_READ | PROT_WRITE,
+	       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (data == MFAIL)
+    return NULL;
+
+  code = mmap (data + STATIC_TRAMP_PAGE, STATIC_TRAMP_PAGE,
+	       PROT_READ | PROT_EXEC, MAP_PRIVATE | MAP_FIXED,
+	       static_tramp_fd, static_tramp_offset);
+  if (code == MFAIL)
+    {
+      munmap (data, 2 * STATIC_TRAMP_PAGE);
+      return NULL;
+    }
+
+  table = (static_tramp_table *) data;
+  slots = (static_tramp_slot *) data;
+  for (i = STATIC_TRAMP_FIRST; i < STATIC_TRAMP_COUNT - 1; i++)
+    slots[i].next = &slots[i + 1];
+  table->free_list = &slots[STATIC_TRAMP_FIRST];
+  table->free_count = STATIC_TRAMP_SLOTS;
+
+  return table;
+}
+
+static struct closure_header *
+static_tramp_alloc (size_t size)
+{
+  static_tramp_table *table;
+  static_tramp_slot *slot;
+  struct closure_header *hdr;
+
+  hdr = malloc (CLOSURE_HEADER + size);
+  if (hdr == NULL)
+    return NULL;
+
+  pthread_mutex_lock (&static_tramp_lock);
+
+  /* Check for an active table with available entries.  */
+  table = static_tramp_tables;
+  if (table == NULL || table->free_list == NULL)
+    {
+      table = static_tramp_table_alloc ();
+      if (table == NULL)
+	{
+	  pthread_mutex_unlock (&static_tramp_lock);
+	  free (hdr);
+	  return NULL;
+	}
+
+      /* Insert the new table at the top of the list.  */
+      table->next = static_tramp_tables;
+      if (table->next != NULL)
+	table->next->prev = table;
+      static_tramp_tables = table;
+    }
+
+  slot = table->free_list;
+  table->free_list = slot->next;
+  table->free_count--;
+  slot->closure = CLOSURE_OF (hdr);
+  slot->next = NULL;
+
+  pthread_mutex_unlock (&static_tramp_lock);
+
+  hdr->code = (char *) slot + STATIC_TRAMP_PAGE;
+  return hdr;
+}
+
+/* Called with the lock held after slots of TABLE have been freed.  */
+static void
+static_tramp_table_release (static_tramp_table *table)
+{
+  /* If all trampolines within this table are free, and at least one
+     other table exists, deallocate the table.  */
+  if (table->free_count == STATIC_TRAMP_SLOTS
+      && static_tramp_tables != table)
+    {
+      if (table->prev != NULL)
+	table->prev->next = table->next;
+      if (table->next != NULL)
+	table->next->prev = table->prev;
+      munmap (table, 2 * STATIC_TRAMP_PAGE);
+    }
+  else if (static_tramp_tables != table)
+    {
+      /* Otherwise, bump this table to the top of the list.  */
+      if (table->prev != NULL)
+	table->prev->next = table->next;
+      if (table->next != NULL)
+	table->next->prev = table->prev;
+      table->prev = NULL;
+      table->next = static_tramp_tables;
+      static_tramp_tables->prev = table;
+      static_tramp_tables = table;
+    }
+}
+
+static void
+static_tramp_free (struct closure_header *hdr)
+{
+  static_tramp_slot *slot;
+  static_tramp_table *table;
+
+  if (hdr == NULL)
+    return;
+
+  slot = (static_tramp_slot *) ((char *) hdr->code - STATIC_TRAMP_PAGE);
+  table = (static_tramp_table *) ((uintptr_t) slot
+				  & ~(uintptr_t) (STATIC_TRAMP_PAGE - 1));
+
+  pthread_mutex_lock (&static_tramp_lock);
+
+  /* Return the entry to the free list.  */
+  slot->closure = NULL;
+  slot->next = table->free_list;
+  table->free_list = slot;
+  table->free_count++;
+
+  static_tramp_table_release (table);
+
+  pthread_mutex_unlock (&static_tramp_lock);
+
+  free (hdr);
+}
+
+/* Find N free slots in a row in TABLE, and take them off its free
+   list.  Free slots are the ones without a closure.  */
+static static_tramp_slot *
+static_tramp_take_run (static_tramp_table *table, unsigned int n)
+{
+  static_tramp_slot *slots = (static_tramp_slot *) table;
+  static_tramp_slot **link;
+  unsigned int i, run = 0;
+
+  if (table->free_count < n)
+    return NULL;
+
+  for (i = STATIC_TRAMP_FIRST; i < STATIC_TRAMP_COUNT && run < n; i++)
+    run = slots[i].closure == NULL ? run + 1 : 0;
+  if (run < n)
+    return NULL;
+  slots += i - n;
+
+  for (link = &table->free_list; *link != NULL; )
+    if (*link >= slots && *link < slots + n)
+      *link = (*link)->next;
+    else
+      link = &(*link)->next;
+  table->free_count -= n;
+  return slots;
+}
+
+/* Allocate N trampolines at consecutive addresses, the Ith of which
+   calls the closure at CLOSURE + I * STRIDE, and return the address
+   of the first.  */
+static void *
+static_tramp_alloc_run (unsigned int n, char *closure, size_t stride)
+{
+  static_tramp_table *table;
+  static_tramp_slot *slots = NULL;
+  unsigned int i;
+
+  if (n > STATIC_TRAMP_SLOTS)
+    return NULL;
+
+  pthread_mutex_lock (&static_tramp_lock);
+
+  for (table = static_tramp_tables; table != NULL; table = table->next)
+    {
+      slots = static_tramp_take_run (table, n);
+      if (slots != NULL)
+	break;
+    }
+  if (slots == NULL)
+    {
+      table = static_tramp_table_alloc ();
+      if (table == NULL)
+	{
+	  pthread_mutex_unlock (&static_tramp_lock);
+	  return NULL;
+	}
+      table->next = static_tramp_tables;
+      if (table->next != NULL)
+	table->next->prev = table;
+      static_tramp_tables = table;
+      slots = static_tramp_take_run (table, n);
+    }
+
+  for (i = 0; i < n; i++)
+    {
+      slots[i].closure = closure + i * stride;
+      slots[i].next = NULL;
+    }
+
+  pthread_mutex_unlock (&static_tramp_lock);
+
+  return (char *) slots + STATIC_TRAMP_PAGE;
+}
+
+static void
+static_tramp_free_run (void *code, unsigned int n)
+{
+  static_tramp_slot *slots;
+  static_tramp_table *table;
+  unsigned int i;
+
+  slots = (static_tramp_slot *) ((char *) code - STATIC_TRAMP_PAGE);
+  table = (static_tramp_table *) ((uintptr_t) slots
+				  & ~(uintptr_t) (STATIC_TRAMP_PAGE - 1));
+
+  pthread_mutex_lock (&static_tramp_lock);
+
+  for (i = 0; i < n; i++)
+    {
+      slots[i].closure = NULL;
+      slots[i].next = table->free_list;
+      table->free_list = &slots[i];
+    }
+  table->free_count += n;
+
+  static_tramp_table_release (table);
+
+  pthread_mutex_unlock (&static_tramp_lock);
+}
+
+static int
+static_tramp_is_enabled (void)
+{
+  int enabled = __atomic_load_n (&static_tramp_enabled, __ATOMIC_ACQUIRE);
+
+  if (enabled < 0)
+    {
+      pthread_mutex_lock (&static_tramp_lock);
+      enabled = static_tramp_enabled;
+      if (enabled < 0)
+	{
+	  enabled = static_tramp_init ();
+	  __atomic_store_n (&static_tramp_enabled, enabled, __ATOMIC_RELEASE);
+	}
+      pthread_mutex_unlock (&static_tramp_lock);
+    }
+  return enabled;
+}
+
+/* Generated code still needs memory that is both written and run, so
+   it comes from the same allocator as closures elsewhere.  */
+# define dl_code_alloc ffi_code_alloc
+# define dl_code_free ffi_code_free
+#elif FFI_CLOSURE_CACHE
+static void *dl_code_alloc (size_t, void **);
+static void dl_code_free (void *);
+#else
+# define dl_code_alloc ffi_closure_alloc
+# define dl_code_free ffi_closure_free
+#endif /* FFI_EXEC_STATIC_TRAMP */
+
 /* Allocate a chunk of memory with the given size.  Returns a pointer
    to the writable address, and sets *CODE to the executable
    corresponding virtual address.  */
 void *
-ffi_closure_alloc (size_t size, void **code)
+dl_code_alloc (size_t size, void **code)
 {
   void *ptr;
 
@@ -926,7 +1417,7 @@ ffi_closure_alloc (size_t size, void **code)
    writable or the executable address given.  Otherwise, only the
    writable address can be provided here.  */
 void
-ffi_closure_free (void *ptr)
+dl_code_free (void *ptr)
 {
 #if FFI_CLOSURE_FREE_CODE
   msegmentptr seg = segment_holding_code (gm, ptr);
@@ -938,6 +1429,313 @@ ffi_closure_free (void *ptr)
   dlfree (ptr);
 }
 
+#if FFI_CLOSURE_CACHE
+
+#define CACHE_GRAIN	32
+#define CACHE_CLASSES	8
+#define CACHE_BATCH	16
+#define CACHE_LIMIT	(2 * CACHE_BATCH)
+
+struct closure_cache
+{
+  struct closure_header *free_list[CACHE_CLASSES];
+  unsigned int free_count[CACHE_CLASSES];
+  /* Closures freed by other threads, linked through next.  */
+  struct closure_header *remote;
+  /* The next cache whose thread has exited.  */
+  struct closure_cache *next;
+};
+
+static struct closure_header *closure_pool[CACHE_CLASSES];
+
+/* Caches left by exited threads, for new threads to take over.  */
+static struct closure_cache *closure_caches_free;
+static pthread_mutex_t closure_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static pthread_once_t closure_cache_once = PTHREAD_ONCE_INIT;
+static pthread_key_t closure_cache_key;
+static __thread struct closure_cache *closure_cache;
+
+/* Allocate a closure of SIZE bytes, with its header, from the static
+   trampolines if they are usable and from dlmalloc otherwise.  */
+static struct closure_header *
+block_alloc (size_t size)
+{
+  struct closure_header *hdr;
+  void *code;
+
+#if FFI_EXEC_STATIC_TRAMP
+  if (static_tramp_is_enabled ())
+    return static_tramp_alloc (size);
+#endif
+
+  hdr = dl_code_alloc (CLOSURE_HEADER + size, &code);
+  if (hdr != NULL)
+    hdr->code = CLOSURE_OF (code);
+  return hdr;
+}
+
+static void
+block_free (struct closure_header *hdr)
+{
+#if FFI_EXEC_STATIC_TRAMP
+  if (static_tramp_is_enabled ())
+    {
+      static_tramp_free (hdr);
+      return;
+    }
+#endif
+
+  dl_code_free (hdr);
+}
+
+/* Push the batches from FIRST to LAST, linked through u.batch, onto
+   the pool for class CLS.  */
+static void
+pool_push (size_t cls, struct closure_header *first,
+	   struct closure_header *last)
+{
+  struct closure_header *old;
+
+  old = __atomic_load_n (&closure_pool[cls], __ATOMIC_RELAXED);
+  do
+    last->u.batch = old;
+  while (!__atomic_compare_exchange_n (&closure_pool[cls], &old, first, 1,
+				       __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+static struct closure_header *
+pool_pop (size_t cls)
+{
+  struct closure_header *batch, *last;
+
+  batch = __atomic_exchange_n (&closure_pool[cls], NULL, __ATOMIC_ACQUIRE);
+  if (batch != NULL && batch->u.batch != NULL)
+    {
+      for (last = batch->u.batch; last->u.batch != NULL; last = last->u.batch)
+	;
+      pool_push (cls, batch->u.batch, last);
+    }
+  return batch;
+}
+
+/* Take back the closures that other threads have freed.  */
+static void
+cache_drain (struct closure_cache *cache)
+{
+  struct closure_header *hdr, *next;
+
+  if (__atomic_load_n (&cache->remote, __ATOMIC_RELAXED) == NULL)
+    return;
+
+  hdr = __atomic_exchange_n (&cache->remote, NULL, __ATOMIC_ACQUIRE);
+  for (; hdr != NULL; hdr = next)
+    {
+      next = hdr->next;
+      hdr->next = cache->free_list[hdr->cls];
+      cache->free_list[hdr->cls] = hdr;
+      cache->free_count[hdr->cls]++;
+    }
+}
+
+/* Called as a thread exits: give its closures to the pool, and keep
+   the cache itself, since closures it allocated may still be freed
+   onto its remote list.  */
+static void
+cache_release (void *arg)
+{
+  struct closure_cache *cache = arg;
+  size_t cls;
+
+  closure_cache = NULL;
+  cache_drain (cache);
+  for (cls = 0; cls < CACHE_CLASSES; cls++)
+    if (cache->free_list[cls] != NULL)
+      {
+	pool_push (cls, cache->free_list[cls], cache->free_list[cls]);
+	cache->free_list[cls] = NULL;
+	cache->free_count[cls] = 0;
+      }
+
+  pthread_mutex_lock (&closure_cache_lock);
+  cache->next = closure_caches_free;
+  closure_caches_free = cache;
+  pthread_mutex_unlock (&closure_cache_lock);
+}
+
+static void
+cache_key_init (void)
+{
+  pthread_key_create (&closure_cache_key, cache_release);
+}
+
+static struct closure_cache *
+cache_get (void)
+{
+  struct closure_cache *cache = closure_cache;
+
+  if (cache != NULL)
+    return cache;
+
+  pthread_once (&closure_cache_once, cache_key_init);
+
+  pthread_mutex_lock (&closure_cache_lock);
+  cache = closure_caches_free;
+  if (cache != NULL)
+    closure_caches_free = cache->next;
+  pthread_mutex_unlock (&closure_cache_lock);
+
+  if (cache == NULL)
+    {
+      cache = calloc (1, sizeof (*cache));
+      if (cache == NULL)
+	return NULL;
+    }
+  cache->next = NULL;
+
+  if (pthread_setspecific (closure_cache_key, cache) != 0)
+    {
+      /* Without a destructor the cache would be lost with the thread;
+	 leave it for another.  */
+      pthread_mutex_lock (&closure_cache_lock);
+      cache->next = closure_caches_free;
+      closure_caches_free = cache;
+      pthread_mutex_unlock (&closure_cache_lock);
+      return NULL;
+    }
+  closure_cache = cache;
+  return cache;
+}
+
+/* Refill the empty free list of class CLS: from the remote frees if
+   there are any, then from the pool, then with a new batch.  */
+static void
+cache_refill (struct closure_cache *cache, size_t cls)
+{
+  struct closure_header *hdr;
+  unsigned int i;
+
+  cache_drain (cache);
+  if (cache->free_list[cls] != NULL)
+    return;
+
+  hdr = pool_pop (cls);
+  if (hdr != NULL)
+    {
+      cache->free_list[cls] = hdr;
+      for (; hdr != NULL; hdr = hdr->next)
+	cache->free_count[cls]++;
+      return;
+    }
+
+  for (i = 0; i < CACHE_BATCH; i++)
+    {
+      hdr = block_alloc ((cls + 1) * CACHE_GRAIN);
+      if (hdr == NULL)
+	break;
+      hdr->cls = cls;
+      hdr->next = cache->free_list[cls];
+      cache->free_list[cls] = hdr;
+      cache->free_count[cls]++;
+    }
+}
+
+/* Give a batch of closures of class CLS back to the pool.  */
+static void
+cache_flush (struct closure_cache *cache, size_t cls)
+{
+  struct closure_header *first, *last;
+  unsigned int i;
+
+  first = last = cache->free_list[cls];
+  for (i = 1; i < CACHE_BATCH; i++)
+    last = last->next;
+  cache->free_list[cls] = last->next;
+  cache->free_count[cls] -= CACHE_BATCH;
+  last->next = NULL;
+
+  pool_push (cls, first, first);
+}
+
+void *
+ffi_closure_alloc (size_t size, void **code)
+{
+  struct closure_cache *cache;
+  struct closure_header *hdr;
+  size_t cls;
+
+  if (!code)
+    return NULL;
+
+  cls = size ? (size - 1) / CACHE_GRAIN : 0;
+  if (cls >= CACHE_CLASSES || (cache = cache_get ()) == NULL)
+    {
+      hdr = block_alloc (size);
+      if (hdr == NULL)
+	return NULL;
+      hdr->u.owner = NULL;
+      hdr->cls = CACHE_CLASSES;
+    }
+  else
+    {
+      if (cache->free_list[cls] == NULL)
+	{
+	  cache_refill (cache, cls);
+	  if (cache->free_list[cls] == NULL)
+	    return NULL;
+	}
+      hdr = cache->free_list[cls];
+      cache->free_list[cls] = hdr->next;
+      cache->free_count[cls]--;
+      hdr->u.owner = cache;
+    }
+
+  *code = hdr->code;
+  return CLOSURE_OF (hdr);
+}
+
+void
+ffi_closure_free (void *ptr)
+{
+  struct closure_header *hdr;
+  struct closure_cache *owner;
+  size_t cls;
+
+  /* Freeing NULL does nothing, as with dlfree.  */
+  if (ptr == NULL)
+    return;
+
+  hdr = HEADER_OF (ptr);
+  owner = hdr->u.owner;
+  cls = hdr->cls;
+
+  if (cls == CACHE_CLASSES)
+    {
+      block_free (hdr);
+      return;
+    }
+
+  if (owner != closure_cache)
+    {
+      struct closure_header *old;
+
+      old = __atomic_load_n (&owner->remote, __ATOMIC_RELAXED);
+      do
+	hdr->next = old;
+      while (!__atomic_compare_exchange_n (&owner->remote, &old, hdr, 1,
+					   __ATOMIC_RELEASE,
+					   __ATOMIC_RELAXED));
+      return;
+    }
+
+  hdr->next = owner->free_list[cls];
+  owner->free_list[cls] = hdr;
+  if (++owner->free_count[cls] > CACHE_LIMIT)
+    cache_flush (owner, cls);
+}
+
+#endif /* FFI_CLOSURE_CACHE */
+
 # else /* ! FFI_MMAP_EXEC_WRIT */
 
 /* On many systems, memory returned by malloc is writable and
@@ -964,3 +1762,203 @@ ffi_closure_free (void *ptr)
 #endif /* FFI_CLOSURES */
 
 #endif /* NetBSD with PROT_MPROTECT */
+
+#if FFI_CLOSURES
+
+/* A closure family is a set of closures with their trampolines in one
+   block of code, sharing one handler that is told which of them was
+   called.  The block starts with the family itself, followed by one
+   slot for each closure.  Where each trampoline must be allocated on
+   its own, as with trampoline tables, the family only points to its
+   slots.  Static trampolines are taken as a run of consecutive
+   entries of one table where possible, with the slots in one block of
+   ordinary memory, and otherwise one at a time.  */
+
+struct ffi_family_slot
+{
+  ffi_closure closure;
+  ffi_closure_family *family;
+  void *code;
+  unsigned int index;
+};
+
+struct ffi_closure_family
+{
+  unsigned int n;
+  void (*fun)(ffi_cif *, void *, void **, unsigned int, void *);
+  void *user_data;
+#if FFI_EXEC_TRAMPOLINE_TABLE || FFI_EXEC_STATIC_TRAMP
+  /* The block holding all the slots, if they were allocated together,
+     and the first of their trampolines if those form a run.  */
+  void *block;
+  void *run;
+  struct ffi_family_slot *slots[1];
+#else
+  struct ffi_family_slot slots[1];
+#endif
+};
+
+#include <stdlib.h>
+
+#if FFI_EXEC_TRAMPOLINE_TABLE || FFI_EXEC_STATIC_TRAMP
+# define FAMILY_SLOT(f, i)	((f)->slots[i])
+#else
+# define FAMILY_SLOT(f, i)	(&(f)->slots[i])
+#endif
+
+static void
+family_handler (ffi_cif *cif, void *rvalue, void **avalue, void *data)
+{
+  struct ffi_family_slot *slot = data;
+  ffi_closure_family *family = slot->family;
+
+  family->fun (cif, rvalue, avalue, slot->index, family->user_data);
+}
+
+#if FFI_EXEC_STATIC_TRAMP
+/* Allocate the slots of FAMILY together, with consecutive trampolines
+   where static trampolines are in use.  */
+static int
+family_alloc_block (ffi_closure_family *family, unsigned int n, void **code)
+{
+  struct ffi_family_slot *block;
+  char *base;
+  size_t stride;
+  unsigned int i;
+
+  if (static_tramp_is_enabled ())
+    {
+      block = calloc (n, sizeof (struct ffi_family_slot));
+      if (block == NULL)
+	return 0;
+      base = static_tramp_alloc_run (n, (char *) block,
+				     sizeof (struct ffi_family_slot));
+      if (base == NULL)
+	{
+	  free (block);
+	  return 0;
+	}
+      family->run = base;
+      stride = STATIC_TRAMP_SIZE;
+    }
+  else
+    {
+      block = ffi_closure_alloc (n * sizeof (struct ffi_family_slot),
+				 (void **) &base);
+      if (block == NULL)
+	return 0;
+      stride = sizeof (struct ffi_family_slot);
+    }
+
+  family->block = block;
+  for (i = 0; i < n; i++)
+    {
+      family->slots[i] = &block[i];
+      code[i] = base + i * stride;
+    }
+  return 1;
+}
+#endif
+
+ffi_closure_family *
+ffi_closure_family_alloc (unsigned int n, void **code)
+{
+  ffi_closure_family *family;
+  size_t size = offsetof (ffi_closure_family, slots)
+		+ n * sizeof (family->slots[0]);
+  unsigned int i;
+
+  if (n == 0 || code == NULL)
+    return NULL;
+
+#if FFI_EXEC_TRAMPOLINE_TABLE || FFI_EXEC_STATIC_TRAMP
+  family = calloc (1, size);
+  if (family == NULL)
+    return NULL;
+# if FFI_EXEC_STATIC_TRAMP
+  if (!family_alloc_block (family, n, code))
+# endif
+    for (i = 0; i < n; i++)
+      {
+	family->slots[i] = ffi_closure_alloc (sizeof (struct ffi_family_slot),
+					      &code[i]);
+	if (family->slots[i] == NULL)
+	  {
+	    family->n = i;
+	    ffi_closure_family_free (family);
+	    return NULL;
+	  }
+      }
+#else
+  {
+    void *base;
+
+    family = ffi_closure_alloc (size, &base);
+    if (family == NULL)
+      return NULL;
+    for (i = 0; i < n; i++)
+      code[i] = (char *) base + ((char *) &family->slots[i] - (char *) family);
+  }
+#endif
+
+  family->n = n;
+  for (i = 0; i < n; i++)
+    {
+      struct ffi_family_slot *slot = FAMILY_SLOT (family, i);
+
+      slot->family = family;
+      slot->code = code[i];
+      slot->index = i;
+    }
+  return family;
+}
+
+ffi_status
+ffi_prep_closure_family (ffi_closure_family *family,
+			 ffi_cif **cifs,
+			 void (*fun)(ffi_cif *, void *, void **,
+				     unsigned int, void *),
+			 void *user_data)
+{
+  unsigned int i;
+
+  family->fun = fun;
+  family->user_data = user_data;
+  for (i = 0; i < family->n; i++)
+    {
+      struct ffi_family_slot *slot = FAMILY_SLOT (family, i);
+      ffi_status status;
+
+      status = ffi_prep_closure_loc (&slot->closure, cifs[i], family_handler,
+				     slot, slot->code);
+      if (status != FFI_OK)
+	return status;
+    }
+  return FFI_OK;
+}
+
+void
+ffi_closure_family_free (ffi_closure_family *family)
+{
+#if FFI_EXEC_TRAMPOLINE_TABLE || FFI_EXEC_STATIC_TRAMP
+  unsigned int i;
+
+# if FFI_EXEC_STATIC_TRAMP
+  if (family->run != NULL)
+    {
+      static_tramp_free_run (family->run, family->n);
+      free (family->block);
+    }
+  else if (family->block != NULL)
+    ffi_closure_free (family->block);
+  else
+# endif
+    for (i = 0; i < family->n; i++)
+      ffi_closure_free (family->slots[i]);
+  free (family);
+#else
+  ffi_closure_free (family);
+#endif
+}
+
+#endif /* FFI_CLOSURES */
@@ -0,0 +1,205 @@
+/* -----------------------------------------------------------------------
+   deferred.c - Copyright (c) 2026  The libffi authors
+
+   Closures that queue their calls for another thread.
+
+   Permission is hereby granted, free of charge, to any person obtaining
+   a copy of this software and associated documentation files (the
+   ``Software''), to deal in the Software without restriction, including
+   without limitation the rights to use, copy, modify, merge, publish,
+   distribute, sublicense, and/or sell copies of the Software, and to
+   permit persons to whom the Software is furnished to do so, subject to
+   the following conditions:
+
+   The above copyright notice and this permission notice shall be included
+   in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED ``AS IS'', WITHOUT WARRANTY OF ANY KIND,
+   EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+   MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+   NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+   HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+   WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+   DEALINGS IN THE SOFTWARE.
+   ----------------------------------------------------------------------- */
+
+#include <ffi.h>
+#include <ffi_common.h>
+
+#if FFI_DEFERRED_CLOSURES
+
+#include <stdlib.h>
+#include <string.h>
+
+/* Calls are queued in a ring of fixed-size slots that any number of
+   threads may write without taking a lock.  A writer claims position
+   POS by advancing TAIL, once the slot's sequence number shows that the
+   reader has finished with it; it then copies the arguments in, packed
+   at the offsets that ffi_get_packed_layout gave when the closure was
+   prepared, and sets the sequence number to POS + 1.  The reader sets
+   it to POS + CAPACITY once it has run the call.  */
+
+struct ffi_deferred_slot
+{
+  size_t seq;
+  ffi_deferred_closure *closure;
+};
+
+#define SLOT_HEADER	FFI_ALIGN (sizeof (struct ffi_deferred_slot), 16)
+
+struct ffi_deferred_queue
+{
+  size_t mask;			/* Capacity of the ring, less one.  */
+  size_t stride;		/* Size of a slot and its arguments.  */
+  size_t arg_size;		/* Room for arguments in each slot.  */
+  size_t tail;			/* Next position for a writer.  */
+  size_t head;			/* Next position for the reader.  */
+  size_t dropped;		/* Calls lost because the ring was full.  */
+  char *ring;
+};
+
+#define SLOT(q, pos) \
+  ((struct ffi_deferred_slot *) ((q)->ring + ((pos) & (q)->mask) * (q)->stride))
+
+ffi_deferred_queue *
+ffi_deferred_queue_alloc (unsigned int capacity, size_t arg_size)
+{
+  ffi_deferred_queue *q;
+  size_t n = 1, i;
+
+  if (capacity == 0)
+    return NULL;
+  while (n < capacity)
+    n <<= 1;
+
+  q = calloc (1, sizeof (*q));
+  if (q == NULL)
+    return NULL;
+  q->mask = n - 1;
+  q->arg_size = arg_size;
+  q->stride = SLOT_HEADER + FFI_ALIGN (arg_size, 16);
+  q->ring = malloc (n * q->stride);
+  if (q->ring == NULL)
+    {
+      free (q);
+      return NULL;
+    }
+  for (i = 0; i < n; i++)
+    SLOT (q, i)->seq = i;
+
+  return q;
+}
+
+void
+ffi_deferred_queue_free (ffi_deferred_queue *q)
+{
+  free (q->ring);
+  free (q);
+}
+
+size_t
+ffi_deferred_dropped (ffi_deferred_queue *q)
+{
+  return __atomic_load_n (&q->dropped, __ATOMIC_RELAXED);
+}
+
+static void
+deferred_handler (ffi_cif *cif, void *rvalue MAYBE_UNUSED, void **avalue,
+		  void *data)
+{
+  ffi_deferred_closure *closure = data;
+  ffi_deferred_queue *q = closure->queue;
+  size_t pos = __atomic_load_n (&q->tail, __ATOMIC_RELAXED);
+  struct ffi_deferred_slot *slot;
+  char *args;
+  unsigned int i;
+
+  for (;;)
+    {
+      ptrdiff_t dif;
+
+      slot = SLOT (q, pos);
+      dif = (ptrdiff_t) (__atomic_load_n (&slot->seq, __ATOMIC_ACQUIRE) - pos);
+      if (dif == 0)
+	{
+	  if (__atomic_compare_exchange_n (&q->tail, &pos, pos + 1, 1,
+					   __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+	    break;
+	}
+      else if (dif < 0)
+	{
+	  /* The reader has not yet run the call CAPACITY positions
+	     back, so the ring is full.  */
+	  __atomic_fetch_add (&q->dropped, 1, __ATOMIC_RELAXED);
+	  return;
+	}
+      else
+	pos = __atomic_load_n (&q->tail, __ATOMIC_RELAXED);
+    }
+
+  slot->closure = closure;
+  args = (char *) slot + SLOT_HEADER;
+  for (i = 0; i < cif->nargs; i++)
+    memcpy (args + closure->offsets[i], avalue[i], cif->arg_types[i]->size);
+
+  __atomic_store_n (&slot->seq, pos + 1, __ATOMIC_RELEASE);
+}
+
+ffi_status
+ffi_prep_deferred_closure (ffi_deferred_closure *closure,
+			   ffi_cif *cif,
+			   ffi_deferred_queue *queue,
+			   void (*fun)(ffi_cif *, void **, void *),
+			   void *user_data,
+			   void *codeloc)
+{
+  if (cif->rtype->type != FFI_TYPE_VOID
+      || cif->nargs > FFI_DEFERRED_MAX_ARGS
+      || ffi_get_packed_layout (cif, closure->offsets) > queue->arg_size)
+    return FFI_BAD_TYPEDEF;
+
+  closure->queue = queue;
+  closure->fun = fun;
+  closure->user_data = user_data;
+
+  return ffi_prep_closure_loc (&closure->closure, cif, deferred_handler,
+			       closure, codeloc);
+}
+
+static void
+deferred_run (struct ffi_deferred_slot *slot)
+{
+  ffi_deferred_closure *closure = slot->closure;
+  ffi_cif *cif = closure->closure.cif;
+  void **avalue = alloca (cif->nargs * sizeof (void *));
+  char *args = (char *) slot + SLOT_HEADER;
+  unsigned int i;
+
+  for (i = 0; i < cif->nargs; i++)
+    avalue[i] = args + closure->offsets[i];
+
+  closure->fun (cif, avalue, closure->user_data);
+}
+
+unsigned int
+ffi_deferred_drain (ffi_deferred_queue *q, unsigned int max)
+{
+  unsigned int n;
+
+  for (n = 0; n < max; n++)
+    {
+      size_t pos = q->head;
+      struct ffi_deferred_slot *slot = SLOT (q, pos);
+
+      if (__atomic_load_n (&slot->seq, __ATOMIC_ACQUIRE) != pos + 1)
+	break;
+
+      deferred_run (slot);
+      __atomic_store_n (&slot->seq, pos + q->mask + 1, __ATOMIC_RELEASE);
+      q->head = pos + 1;
+    }
+  return n;
+}
+
+#endif /* FFI_DEFERRED_CLOSURES */
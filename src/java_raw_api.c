@@ -240,7 +240,7 @@ ffi_java_ptrarray_to_raw (ffi_cif *cif, void **args, ffi_java_raw *raw)
     }
 }
 
-#if !FFI_NATIVE_RAW_API
+#if !FFI_NATIVE_RAW_API && !FFI_NATIVE_JAVA_RAW_CALL
 
 static void
 ffi_java_rvalue_to_raw (ffi_cif *cif, void *rvalue)
@@ -370,5 +370,5 @@ ffi_prep_java_raw_closure (ffi_java_raw_closure* cl,
 }
 
 #endif /* FFI_CLOSURES */
-#endif /* !FFI_NATIVE_RAW_API */
+#endif /* !FFI_NATIVE_RAW_API && !FFI_NATIVE_JAVA_RAW_CALL */
 #endif /* !NO_JAVA_RAW_API */
@@ -26,6 +26,7 @@
 #include <ffi.h>
 #include <ffi_common.h>
 #include <stdlib.h>
+#include <string.h>
 
 /* Round up to FFI_SIZEOF_ARG. */
 
@@ -232,6 +233,153 @@ ffi_status ffi_prep_cif_var(ffi_cif *cif,
   return ffi_prep_cif_core(cif, abi, 1, nfixedargs, ntotalargs, rtype, atypes);
 }
 
+/* A variadic cif holds the fixed arguments, checked once, and a full
+   cif for each list of variadic argument types it has been used with.
+   The full cifs are kept in a hash table keyed by the addresses of the
+   variadic argument types, and are not freed until the variadic cif
+   is.  */
+
+struct ffi_var_tail
+{
+  struct ffi_var_tail *next;
+  size_t hash;
+  unsigned int ntailargs;
+  ffi_cif cif;
+  ffi_type *atypes[];		/* Fixed, then variadic, argument types.  */
+};
+
+struct ffi_var_cif
+{
+  ffi_abi abi;
+  ffi_type *rtype;
+  unsigned int nfixedargs;
+  size_t mask, count;
+  struct ffi_var_tail **table;
+  ffi_type *atypes[];		/* The fixed argument types.  */
+};
+
+ffi_var_cif *
+ffi_var_cif_alloc (ffi_abi abi, unsigned int nfixedargs,
+		   ffi_type *rtype, ffi_type **atypes)
+{
+  ffi_var_cif *vc;
+  ffi_cif cif;
+
+  FFI_ASSERT(nfixedargs >= 1);
+
+  /* Initialize and check the return and fixed argument types.  */
+  if (ffi_prep_cif_var (&cif, abi, nfixedargs, nfixedargs,
+			rtype, atypes) != FFI_OK)
+    return NULL;
+
+  vc = (ffi_var_cif *) malloc (sizeof (*vc) + nfixedargs * sizeof (ffi_type *));
+  if (vc == NULL)
+    return NULL;
+  vc->table = (struct ffi_var_tail **) calloc (16, sizeof (*vc->table));
+  if (vc->table == NULL)
+    {
+      free (vc);
+      return NULL;
+    }
+
+  vc->abi = abi;
+  vc->rtype = rtype;
+  vc->nfixedargs = nfixedargs;
+  vc->mask = 15;
+  vc->count = 0;
+  memcpy (vc->atypes, atypes, nfixedargs * sizeof (ffi_type *));
+  return vc;
+}
+
+static size_t
+var_tail_hash (unsigned int ntailargs, ffi_type **atypes)
+{
+  size_t h = ntailargs;
+  unsigned int i;
+
+  for (i = 0; i < ntailargs; i++)
+    h = (h ^ ((size_t) atypes[i] >> 4)) * 0x9e3779b1u;
+  return h ^ (h >> 15);
+}
+
+static void
+var_cif_grow (ffi_var_cif *vc)
+{
+  size_t n = 2 * (vc->mask + 1), i;
+  struct ffi_var_tail **table, *t, *next;
+
+  table = (struct ffi_var_tail **) calloc (n, sizeof (*table));
+  if (table == NULL)
+    return;
+
+  for (i = 0; i <= vc->mask; i++)
+    for (t = vc->table[i]; t != NULL; t = next)
+      {
+	next = t->next;
+	t->next = table[t->hash & (n - 1)];
+	table[t->hash & (n - 1)] = t;
+      }
+
+  free (vc->table);
+  vc->table = table;
+  vc->mask = n - 1;
+}
+
+ffi_cif *
+ffi_var_cif_get (ffi_var_cif *vc, unsigned int ntailargs, ffi_type **atypes)
+{
+  size_t hash = var_tail_hash (ntailargs, atypes);
+  unsigned int nfixed = vc->nfixedargs;
+  struct ffi_var_tail *t, **head;
+
+  head = &vc->table[hash & vc->mask];
+  for (t = *head; t != NULL; t = t->next)
+    if (t->hash == hash && t->ntailargs == ntailargs
+	&& memcmp (t->atypes + nfixed, atypes,
+		   ntailargs * sizeof (ffi_type *)) == 0)
+      return &t->cif;
+
+  t = (struct ffi_var_tail *)
+    malloc (sizeof (*t) + (nfixed + ntailargs) * sizeof (ffi_type *));
+  if (t == NULL)
+    return NULL;
+  memcpy (t->atypes, vc->atypes, nfixed * sizeof (ffi_type *));
+  memcpy (t->atypes + nfixed, atypes, ntailargs * sizeof (ffi_type *));
+
+  /* The fixed types are already initialized, so only the variadic
+     ones need any work before the machine dependent part.  */
+  if (ffi_prep_cif_core (&t->cif, vc->abi, 1, nfixed, nfixed + ntailargs,
+			 vc->rtype, t->atypes) != FFI_OK)
+    {
+      free (t);
+      return NULL;
+    }
+
+  t->hash = hash;
+  t->ntailargs = ntailargs;
+  t->next = *head;
+  *head = t;
+  if (++vc->count > vc->mask)
+    var_cif_grow (vc);
+  return &t->cif;
+}
+
+void
+ffi_var_cif_free (ffi_var_cif *vc)
+{
+  struct ffi_var_tail *t, *next;
+  size_t i;
+
+  for (i = 0; i <= vc->mask; i++)
+    for (t = vc->table[i]; t != NULL; t = next)
+      {
+	next = t->next;
+	free (t);
+      }
+  free (vc->table);
+  free (vc);
+}
+
 #if FFI_CLOSURES
 
 ffi_status
@@ -259,3 +407,164 @@ ffi_get_struct_offsets (ffi_abi abi, ffi_type *struct_type, size_t *offsets)
 
   return initialize_aggregate(struct_type, offsets);
 }
+
+/* Arguments in a packed buffer are laid out like the members of a
+   struct: each at the next offset suitably aligned for its type.  */
+
+size_t
+ffi_get_packed_layout (ffi_cif *cif, size_t *offsets)
+{
+  size_t off = 0;
+  unsigned int i;
+
+  for (i = 0; i < cif->nargs; i++)
+    {
+      ffi_type *type = cif->arg_types[i];
+
+      off = FFI_ALIGN (off, type->alignment);
+      if (offsets)
+	offsets[i] = off;
+      off += type->size;
+    }
+
+  return off;
+}
+
+#if !FFI_NATIVE_PACKED_CALL
+
+/* This is a generic definition of ffi_call_packed, used if the target
+   does not load the arguments from the packed buffer itself.  */
+
+void
+ffi_call_packed (ffi_cif *cif, void (*fn)(void), void *rvalue, void *args)
+{
+  void **avalue = (void **) alloca (cif->nargs * sizeof (void *));
+  size_t off = 0;
+  unsigned int i;
+
+  for (i = 0; i < cif->nargs; i++)
+    {
+      ffi_type *type = cif->arg_types[i];
+
+      off = FFI_ALIGN (off, type->alignment);
+      avalue[i] = (char *) args + off;
+      off += type->size;
+    }
+
+  ffi_call (cif, fn, rvalue, avalue);
+}
+
+#endif
+
+#if !FFI_NATIVE_BATCH_CALL
+
+/* This is a generic definition of ffi_call_batch, used if the target
+   has no cheaper way to repeat a call.  */
+
+void
+ffi_call_batch (ffi_cif *cif, void (*fn)(void), size_t count,
+		void **rvalues, void ***avalues)
+{
+  size_t k;
+
+  for (k = 0; k < count; k++)
+    ffi_call (cif, fn, rvalues ? rvalues[k] : NULL, avalues[k]);
+}
+
+void
+ffi_call_strided (ffi_cif *cif, void (*fn)(void), size_t count,
+		  void *rvalues, size_t rstride,
+		  void **columns, const size_t *strides)
+{
+  void **avalue = (void **) alloca (cif->nargs * sizeof (void *));
+  char *rvalue = (char *) rvalues;
+  unsigned int i;
+  size_t k;
+
+  for (i = 0; i < cif->nargs; i++)
+    avalue[i] = columns[i];
+  if (rvalue == NULL)
+    rstride = 0;
+
+  for (k = 0; k < count; k++, rvalue += rstride)
+    {
+      ffi_call (cif, fn, rvalue, avalue);
+      for (i = 0; i < cif->nargs; i++)
+	avalue[i] = (char *) avalue[i] + strides[i];
+    }
+}
+
+#endif
+
+#if !FFI_NATIVE_CALL_ON_STACK
+
+/* This is a generic definition of ffi_call_on_stack, used if the target
+   cannot switch stacks for a call.  The call is not made.  */
+
+ffi_status
+ffi_call_on_stack (ffi_cif *cif, void (*fn)(void), void *rvalue,
+		   void **avalue, void *stack, size_t size)
+{
+  return FFI_BAD_ABI;
+}
+
+#endif
+
+#if !FFI_NATIVE_CALLSITE
+
+/* This is a generic definition of call sites, which keep the argument
+   values in a packed buffer and pass them to ffi_call.  */
+
+struct ffi_callsite
+{
+  ffi_cif *cif;
+  void (*fn)(void);
+  void **slot;
+};
+
+ffi_callsite *
+ffi_callsite_alloc (ffi_cif *cif, void (*fn)(void))
+{
+  ffi_callsite *site;
+  size_t head, off = 0;
+  char *values;
+  unsigned int i;
+
+  head = FFI_ALIGN (sizeof (*site) + cif->nargs * sizeof (void *), 16);
+  site = (ffi_callsite *) calloc (1, head + ffi_get_packed_layout (cif, NULL));
+  if (site == NULL)
+    return NULL;
+
+  site->cif = cif;
+  site->fn = fn;
+  site->slot = (void **) (site + 1);
+  values = (char *) site + head;
+  for (i = 0; i < cif->nargs; i++)
+    {
+      off = FFI_ALIGN (off, cif->arg_types[i]->alignment);
+      site->slot[i] = values + off;
+      off += cif->arg_types[i]->size;
+    }
+
+  return site;
+}
+
+void *
+ffi_callsite_arg (ffi_callsite *site, unsigned int n)
+{
+  return site->slot[n];
+}
+
+void
+ffi_callsite_call (ffi_callsite *site, void *rvalue)
+{
+  ffi_call (site->cif, site->fn, rvalue, site->slot);
+}
+
+void
+ffi_callsite_free (ffi_callsite *site)
+{
+  free (site);
+}
+
+#endif
@@ -192,7 +192,7 @@ ffi_ptrarray_to_raw (ffi_cif *cif, void **args, ffi_raw *raw)
     }
 }
 
-#if !FFI_NATIVE_RAW_API
+#if !FFI_NATIVE_RAW_API && !FFI_NATIVE_RAW_CALL
 
 
 /* This is a generic definition of ffi_raw_call, to be used if the
@@ -246,7 +246,7 @@ ffi_prep_raw_closure_loc (ffi_raw_closure* cl,
 }
 
 #endif /* FFI_CLOSURES */
-#endif /* !FFI_NATIVE_RAW_API */
+#endif /* !FFI_NATIVE_RAW_API && !FFI_NATIVE_RAW_CALL */
 
 #if FFI_CLOSURES
 
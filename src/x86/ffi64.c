@@ -32,6 +32,7 @@
 
 #include <stdlib.h>
 #include <stdarg.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdbool.h>
 #include "internal64.h"
@@ -69,6 +70,39 @@ struct register_args
   UINT64 r10;	/* static chain */
 };
 
+/* Word offsets within struct register_args, as recorded in the
+   reg field of ffi_x86_64_arg.  */
+#define REG_ARGS_GPR(N)	(N)
+#define REG_ARGS_SSE(N)	(MAX_GPR_REGS + 2 * (N))
+
+#define UNIX64_NSSE(FLAGS) \
+  (((FLAGS) >> UNIX64_NSSE_SHIFT) & UNIX64_NSSE_MASK)
+
+/* Where each argument of a unix64 cif is passed is worked out when the
+   cif is prepared, so that calls and closures need not classify the
+   arguments again.  Only cifs with up to PLAN_ARGS arguments get such
+   a plan, and have UNIX64_FLAG_ARG_PLAN set.  */
+#define PLAN_ARGS 16
+
+typedef struct {
+  unsigned char op[2];		/* How each eightbyte is loaded.  */
+  unsigned char reg[2];		/* Register slot of each eightbyte.  */
+  unsigned char len[2];		/* Bytes in each eightbyte.  */
+  unsigned short stack;		/* Stack offset in words.  */
+} ffi_x86_64_arg;
+
+struct cif_plan
+{
+  void *stub;			/* Tiered call stub, or NULL.  */
+  ffi_x86_64_arg args[PLAN_ARGS];
+};
+
+/* The closure entry points read these fields of the cif.  */
+typedef char unix64_cif_bytes_check
+  [offsetof (ffi_cif, bytes) == UNIX64_CIF_BYTES ? 1 : -1];
+typedef char unix64_cif_flags_check
+  [offsetof (ffi_cif, flags) == UNIX64_CIF_FLAGS ? 1 : -1];
+
 extern void ffi_call_unix64 (void *args, unsigned long bytes, unsigned flags,
 			     void *raddr, void (*fnaddr)(void)) FFI_HIDDEN;
 
@@ -520,6 +554,262 @@ examine_argument (ffi_type *type, enum x86_64_reg_class classes[MAX_CLASSES],
   return n;
 }
 
+/* Return the number of SSE registers taken by an argument classified
+   into the N CLASSES.  An SSEUP eightbyte continues the register begun
+   by the one before it, unless it starts a new pair.  */
+
+static int
+sse_registers (enum x86_64_reg_class classes[MAX_CLASSES], size_t n)
+{
+  unsigned int j;
+  int nsse = 0;
+
+  for (j = 0; j < n; j++)
+    if (classes[j] == X86_64_SSE_CLASS
+	|| (classes[j] == X86_64_SSEUP_CLASS && j % 2 == 0))
+      nsse++;
+  return nsse;
+}
+
+/* Record in ARG how an argument of TYPE, classified into the N
+   CLASSES by examine_argument, is loaded into struct register_args
+   when its first registers are GPRCOUNT and SSECOUNT.  */
+
+static void
+plan_register_arg (ffi_x86_64_arg *arg, ffi_type *type,
+		   enum x86_64_reg_class classes[MAX_CLASSES], size_t n,
+		   int gprcount, int ssecount)
+{
+  size_t size = type->size;
+  unsigned int j;
+
+  memset (arg, 0, sizeof (*arg));
+  for (j = 0; j < n; j++, size -= 8)
+    switch (classes[j])
+      {
+      case X86_64_NO_CLASS:
+	break;
+      case X86_64_INTEGER_CLASS:
+	/* Sign-extend integer arguments passed in general purpose
+	   registers, to cope with the fact that LLVM incorrectly
+	   assumes that this will be done (the x86-64 PS ABI does
+	   not specify this). */
+	switch (type->type)
+	  {
+	  case FFI_TYPE_SINT8:
+	    arg->op[j] = UNIX64_ARG_SINT8;
+	    break;
+	  case FFI_TYPE_SINT16:
+	    arg->op[j] = UNIX64_ARG_SINT16;
+	    break;
+	  case FFI_TYPE_SINT32:
+	    arg->op[j] = UNIX64_ARG_SINT32;
+	    break;
+	  default:
+	    arg->op[j] = UNIX64_ARG_INT;
+	    break;
+	  }
+	arg->reg[j] = REG_ARGS_GPR (gprcount++);
+	arg->len[j] = size < 8 ? size : 8;
+	break;
+      case X86_64_SSE_CLASS:
+	arg->op[j] = UNIX64_ARG_SSE;
+	arg->reg[j] = REG_ARGS_SSE (ssecount++);
+	arg->len[j] = size > 4 ? 8 : 4;
+	break;
+      case X86_64_SSEUP_CLASS:
+	/* The upper half of the register begun by the previous
+	   eightbyte.  */
+	FFI_ASSERT (j == 1);
+	arg->op[j] = UNIX64_ARG_SSE;
+	arg->reg[j] = REG_ARGS_SSE (ssecount - 1) + 1;
+	arg->len[j] = size < 8 ? size : 8;
+	break;
+      default:
+	abort ();
+      }
+}
+
+/* Go over the arguments of CIF and determine the way they should be
+   passed, when GPRCOUNT general registers are already taken.  If it's
+   in a register and there is space for it, let that be so.  If not,
+   add its size to the stack byte count.  Record the placement of each
+   argument in ARGS as we go, and return whether all of them fit.  The
+   SSE registers and stack bytes used are stored in *PNSSE and
+   *PBYTES.  */
+
+static _Bool
+place_args (ffi_cif *cif, int gprcount, ffi_x86_64_arg *args,
+	    int *pnsse, size_t *pbytes)
+{
+  enum x86_64_reg_class classes[MAX_CLASSES];
+  int ssecount = 0, ngpr, nsse;
+  size_t bytes = 0, n;
+  unsigned int i, avn = cif->nargs;
+  _Bool plan = avn <= PLAN_ARGS;
+
+  for (i = 0; i < avn; i++)
+    {
+      n = examine_argument (cif->arg_types[i], classes, 0, &ngpr, &nsse, false);
+      if (n == 0
+	  || gprcount + ngpr > MAX_GPR_REGS
+	  || ssecount + nsse > MAX_SSE_REGS)
+	{
+	  long align = cif->arg_types[i]->alignment;
+
+	  if (align < 8)
+	    align = 8;
+
+	  bytes = FFI_ALIGN (bytes, align);
+	  if (plan && bytes / 8 <= 0xffff)
+	    {
+	      memset (&args[i], 0, sizeof (ffi_x86_64_arg));
+	      args[i].op[0] = UNIX64_ARG_STACK;
+	      args[i].stack = (unsigned short) (bytes / 8);
+	    }
+	  else
+	    plan = 0;
+	  bytes += cif->arg_types[i]->size;
+	}
+      else
+	{
+	  if (plan && n > 2)
+	    plan = 0;
+	  if (plan)
+	    plan_register_arg (&args[i], cif->arg_types[i], classes, n,
+			       gprcount, ssecount);
+	  gprcount += ngpr;
+	  ssecount += sse_registers (classes, n);
+	}
+    }
+
+  *pnsse = ssecount;
+  *pbytes = bytes;
+  return plan;
+}
+
+/* Plans are kept in a table beside the cifs rather than in them, as
+   callers allocate ffi_cif and its size is part of the ABI.  The table
+   is a cache indexed by the address of the cif.  A slot holds the plan
+   of the last cif stored there, with the fields of that cif, and a
+   lookup checks them against its own cif.  On a miss, as for a cif
+   that was copied or whose slot another cif has since taken, the plan
+   is made again and stored.  Each slot has a sequence count that is
+   odd while the slot is written, so that lookups take no lock; a
+   writer that finds the slot busy leaves it alone.  */
+
+#define PLAN_SLOTS 256
+
+struct plan_slot
+{
+  unsigned seq;
+  unsigned calls;		/* Calls made, for --enable-call-tiering.  */
+  ffi_type *rtype;
+  unsigned nargs, flags, bytes;
+  ffi_type *types[PLAN_ARGS];
+  struct cif_plan plan;
+};
+
+static struct plan_slot plan_table[PLAN_SLOTS];
+
+#define PLAN_SLOT(CIF) \
+  (&plan_table[(((uintptr_t) (CIF) >> 3) ^ ((uintptr_t) (CIF) >> 11)) \
+	       % PLAN_SLOTS])
+
+static _Bool
+plan_matches (const struct plan_slot *s, const ffi_cif *cif)
+{
+  unsigned int i;
+
+  if (s->rtype != cif->rtype || s->nargs != cif->nargs
+      || s->flags != cif->flags || s->bytes != cif->bytes)
+    return 0;
+  for (i = 0; i < cif->nargs; i++)
+    if (s->types[i] != cif->arg_types[i])
+      return 0;
+  return 1;
+}
+
+/* Take the slot S for writing and store its sequence count in *PSEQ,
+   or return 0 if another thread is writing it.  */
+
+static _Bool
+plan_slot_lock (struct plan_slot *s, unsigned *pseq)
+{
+  unsigned seq = __atomic_load_n (&s->seq, __ATOMIC_RELAXED);
+
+  if ((seq & 1)
+      || !__atomic_compare_exchange_n (&s->seq, &seq, seq + 1, 0,
+				       __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+    return 0;
+  *pseq = seq;
+  return 1;
+}
+
+static void
+plan_slot_unlock (struct plan_slot *s, unsigned seq)
+{
+  __atomic_store_n (&s->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+/* Store the plan P of CIF, unless its slot already holds it.  */
+
+static void
+plan_store (ffi_cif *cif, const struct cif_plan *p)
+{
+  struct plan_slot *s = PLAN_SLOT (cif);
+  unsigned seq;
+
+  if (plan_matches (s, cif) || !plan_slot_lock (s, &seq))
+    return;
+
+  s->rtype = cif->rtype;
+  s->nargs = cif->nargs;
+  s->flags = cif->flags;
+  s->bytes = cif->bytes;
+  memcpy (s->types, cif->arg_types, cif->nargs * sizeof (ffi_type *));
+  s->plan.stub = p->stub;
+  memcpy (s->plan.args, p->args, cif->nargs * sizeof (ffi_x86_64_arg));
+  __atomic_store_n (&s->calls, 0, __ATOMIC_RELAXED);
+  plan_slot_unlock (s, seq);
+}
+
+/* Copy the plan of CIF into P, if the table holds it.  */
+
+static _Bool
+plan_lookup (ffi_cif *cif, struct cif_plan *p)
+{
+  struct plan_slot *s = PLAN_SLOT (cif);
+  unsigned seq = __atomic_load_n (&s->seq, __ATOMIC_ACQUIRE);
+
+  if ((seq & 1) || !plan_matches (s, cif))
+    return 0;
+  p->stub = s->plan.stub;
+  memcpy (p->args, s->plan.args, cif->nargs * sizeof (ffi_x86_64_arg));
+  __atomic_thread_fence (__ATOMIC_ACQUIRE);
+  return __atomic_load_n (&s->seq, __ATOMIC_RELAXED) == seq;
+}
+
+/* Return the plan of CIF, held in P, or NULL if CIF has none.  */
+
+static const ffi_x86_64_arg *
+cif_plan (ffi_cif *cif, struct cif_plan *p)
+{
+  size_t bytes;
+  int nsse;
+
+  if (cif->abi != FFI_UNIX64 || !(cif->flags & UNIX64_FLAG_ARG_PLAN))
+    return NULL;
+  if (!plan_lookup (cif, p))
+    {
+      place_args (cif, (cif->flags & UNIX64_FLAG_RET_IN_MEM) != 0, p->args,
+		  &nsse, &bytes);
+      p->stub = NULL;
+      plan_store (cif, p);
+    }
+  return p->args;
+}
+
 /* Perform machine dependent cif processing.  */
 
 #ifndef __ILP32__
@@ -535,6 +825,8 @@ ffi_prep_cif_machdep (ffi_cif *cif)
   enum x86_64_reg_class classes[MAX_CLASSES];
   size_t bytes, n, rtype_size;
   ffi_type *rtype;
+  struct cif_plan p;
+  _Bool plan;
 
 #ifndef __ILP32__
   if (cif->abi == FFI_EFI64 || cif->abi == FFI_GNUW64)
@@ -667,64 +959,289 @@ ffi_prep_cif_machdep (ffi_cif *cif)
       return FFI_BAD_TYPEDEF;
     }
 
-  /* Go over all arguments and determine the way they should be passed.
-     If it's in a register and there is space for it, let that be so. If
-     not, add it's size to the stack byte count.  */
-  for (bytes = 0, i = 0, avn = cif->nargs; i < avn; i++)
+  avn = cif->nargs;
+  plan = place_args (cif, gprcount, p.args, &ssecount, &bytes);
+  if (ssecount)
+    flags |= UNIX64_FLAG_XMM_ARGS;
+  flags |= (unsigned) ssecount << UNIX64_NSSE_SHIFT;
+  if (plan)
+    flags |= UNIX64_FLAG_ARG_PLAN;
+
+  /* Calls that pass each argument in a single register, and return
+     nothing or a scalar, need none of the generic call machinery.  */
+  if (plan && bytes == 0
+      && !(flags & UNIX64_FLAG_RET_IN_MEM)
+      && (flags & 0xff) <= UNIX64_RET_XMM64)
     {
-      if (examine_argument (cif->arg_types[i], classes, 0, &ngpr, &nsse, false) == 0
-	  || gprcount + ngpr > MAX_GPR_REGS
-	  || ssecount + nsse > MAX_SSE_REGS)
-	{
-	  long align = cif->arg_types[i]->alignment;
+      for (i = 0; i < avn; i++)
+	if (p.args[i].op[1] != UNIX64_ARG_NONE)
+	  break;
+      if (i == avn)
+	flags |= UNIX64_FLAG_SCALAR;
+    }
 
-	  if (align < 8)
-	    align = 8;
+  cif->flags = flags;
+  cif->bytes = (unsigned) FFI_ALIGN (bytes, 8);
 
-	  bytes = FFI_ALIGN (bytes, align);
-	  bytes += cif->arg_types[i]->size;
-	}
+  if (plan)
+    {
+      p.stub = NULL;
+      plan_store (cif, &p);
+    }
+
+  return FFI_OK;
+}
+
+/* The space a call needs for the register image, the stack arguments
+   and the 4 words of temp space that ffi_call_unix64 uses.  */
+#define CALL_FRAME_SIZE(CIF) \
+  FFI_ALIGN (sizeof (struct register_args) + (CIF)->bytes + 4*8, 16)
+
+#ifdef FFI_HEAP_CALL_FRAMES
+
+/* With --enable-heap-call-frames, calls do not allocate their argument
+   area on the stack.  Each thread instead keeps a frame on the heap,
+   grown to fit the largest cif it has called, whose top holds the
+   arguments and below which CALL_FRAME_STACK bytes are left for the
+   callee, which runs on it.  This keeps huge by-value arguments off
+   small thread stacks.  A call made while the frame is in use, from
+   a closure for instance, falls back to the stack.
+
+   A callee that unwinds out of the call, by an exception or longjmp,
+   never releases the frame.  So the frame also records the stack
+   address of the call that took it.  A later call that is neither
+   running on the frame nor nested below that call can only be made
+   once that call has gone, and takes the frame back.  */
+
+#include <sys/mman.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#define CALL_FRAME_STACK	(1024 * 1024)
+
+struct call_frame
+{
+  char *base;
+  size_t size;
+  char *caller;			/* Stack address of the call using it.  */
+  int busy;
+};
+
+static __thread struct call_frame call_frame;
+static pthread_key_t call_frame_key;
+static pthread_once_t call_frame_once = PTHREAD_ONCE_INIT;
+
+static void
+call_frame_free (void *p)
+{
+  struct call_frame *f = p;
+
+  munmap (f->base, f->size);
+  f->base = NULL;
+  f->size = 0;
+}
+
+static void
+call_frame_init (void)
+{
+  pthread_key_create (&call_frame_key, call_frame_free);
+}
+
+/* Return the top SIZE bytes, a multiple of 16, of this thread's frame,
+   or NULL if the frame is in use or cannot be grown.  */
+
+static char *
+call_frame_acquire (size_t size)
+{
+  struct call_frame *f = &call_frame;
+  char *sp = __builtin_frame_address (0);
+
+  if (f->busy
+      && ((sp >= f->base && sp < f->base + f->size) || sp < f->caller))
+    return NULL;
+
+  if (f->size < CALL_FRAME_STACK + size)
+    {
+      size_t page = sysconf (_SC_PAGESIZE);
+      size_t n = FFI_ALIGN (CALL_FRAME_STACK + size + page, page);
+      char *p;
+
+      p = mmap (NULL, n, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON,
+		-1, 0);
+      if (p == MAP_FAILED)
+	return NULL;
+
+      /* A guard page catches callees that overrun their stack.  */
+      mprotect (p, page, PROT_NONE);
+
+      if (f->base != NULL)
+	munmap (f->base, f->size);
       else
 	{
-	  gprcount += ngpr;
-	  ssecount += nsse;
+	  pthread_once (&call_frame_once, call_frame_init);
+	  pthread_setspecific (call_frame_key, f);
 	}
+      f->base = p;
+      f->size = n;
     }
-  if (ssecount)
-    flags |= UNIX64_FLAG_XMM_ARGS;
 
-  cif->flags = flags;
-  cif->bytes = (unsigned) FFI_ALIGN (bytes, 8);
+  f->busy = 1;
+  f->caller = sp;
+  return f->base + f->size - size;
+}
 
-  return FFI_OK;
+static void
+call_frame_release (void)
+{
+  call_frame.busy = 0;
+}
+
+#else
+
+#define call_frame_acquire(SIZE)	NULL
+#define call_frame_release()		((void) 0)
+
+#endif /* FFI_HEAP_CALL_FRAMES */
+
+/* Copy the value at A into the place ARG records for it, REG_ARGS or
+   the stack argument area at ARGP.  */
+
+static inline void
+plan_load_arg (const ffi_x86_64_arg *arg, size_t size,
+	       struct register_args *reg_args, char *argp, const char *a)
+{
+  unsigned int j;
+
+  if (arg->op[0] == UNIX64_ARG_STACK)
+    {
+      memcpy (argp + arg->stack * 8, a, size);
+      return;
+    }
+
+  for (j = 0; j < 2; j++, a += 8)
+    {
+      UINT64 *r = (UINT64 *) reg_args + arg->reg[j];
+
+      switch (arg->op[j])
+	{
+	case UNIX64_ARG_NONE:
+	  break;
+	case UNIX64_ARG_INT:
+	  *r = 0;
+	  memcpy (r, a, arg->len[j]);
+	  break;
+	case UNIX64_ARG_SINT8:
+	  *r = (SINT64) *((const SINT8 *) a);
+	  break;
+	case UNIX64_ARG_SINT16:
+	  *r = (SINT64) *((const SINT16 *) a);
+	  break;
+	case UNIX64_ARG_SINT32:
+	  *r = (SINT64) *((const SINT32 *) a);
+	  break;
+	case UNIX64_ARG_SSE:
+	  memcpy (r, a, arg->len[j]);
+	  break;
+	default:
+	  abort ();
+	}
+    }
 }
 
+/* The layouts of a raw argument buffer.  */
+enum raw_layout { RAW_NONE, RAW_PLAIN, RAW_JAVA };
+
+/* Perform a call for a cif with the argument plan PLAN, where we need
+   only copy the values into place.  The values come either from
+   AVALUE or from the PACKED buffer, which holds the arguments in the
+   layout of ffi_call_packed, or of ffi_raw_call if RAW is RAW_PLAIN,
+   or of ffi_java_raw_call if RAW is RAW_JAVA.  FLAGS and
+   RVALUE have already been adjusted for a missing return address.
+   The call runs on FRAME, as returned by call_frame_acquire, if that
+   is not NULL; otherwise the argument area is allocated here.  */
+
 static void
-ffi_call_int (ffi_cif *cif, void (*fn)(void), void *rvalue,
-	      void **avalue, void *closure)
+ffi_call_plan (ffi_cif *cif, const ffi_x86_64_arg *plan, void (*fn)(void),
+	       int flags, void *rvalue, void **avalue, const char *packed,
+	       int raw, void *closure, char *frame)
 {
-  enum x86_64_reg_class classes[MAX_CLASSES];
-  char *stack, *argp;
-  ffi_type **arg_types;
-  int gprcount, ssecount, ngpr, nsse, i, avn, flags;
+  const ffi_x86_64_arg *arg = plan;
+  ffi_type **arg_types = cif->arg_types;
   struct register_args *reg_args;
+  char *stack, *argp;
+  size_t off = 0;
+  int i, avn = cif->nargs;
 
-  /* Can't call 32-bit mode from 64-bit mode.  */
-  FFI_ASSERT (cif->abi == FFI_UNIX64);
+  /* Allocate the space for the arguments, plus 4 words of temp space.  */
+  stack = frame ? frame : alloca (CALL_FRAME_SIZE (cif));
+  reg_args = (struct register_args *) stack;
+  argp = stack + sizeof (struct register_args);
 
-  /* If the return value is a struct and we don't have a return value
-     address then we need to make one.  Otherwise we can ignore it.  */
-  flags = cif->flags;
-  if (rvalue == NULL)
+  reg_args->r10 = (uintptr_t) closure;
+  if (flags & UNIX64_FLAG_RET_IN_MEM)
+    reg_args->gpr[0] = (unsigned long) rvalue;
+
+  for (i = 0; i < avn; ++i, ++arg)
     {
-      if (flags & UNIX64_FLAG_RET_IN_MEM)
-	rvalue = alloca (cif->rtype->size);
+      const char *a;
+
+      if (raw)
+	{
+	  /* Structures are passed by reference; other values are
+	     padded to whole ffi_raw slots.  */
+	  switch (arg_types[i]->type)
+	    {
+	    case FFI_TYPE_STRUCT:
+	    case FFI_TYPE_EXT_VECTOR:
+	    case FFI_TYPE_COMPLEX:
+	      a = ((const ffi_raw *) packed)->ptr;
+	      packed += sizeof (ffi_raw);
+	      break;
+	    case FFI_TYPE_UINT64:
+	    case FFI_TYPE_SINT64:
+	    case FFI_TYPE_DOUBLE:
+	      /* Java leaves an empty slot after 64-bit values.  */
+	      a = packed;
+	      packed += (raw == RAW_JAVA ? 2 : 1) * sizeof (ffi_raw);
+	      break;
+	    default:
+	      a = packed;
+	      packed += FFI_ALIGN (arg_types[i]->size, FFI_SIZEOF_ARG);
+	      break;
+	    }
+	}
+      else if (packed)
+	{
+	  off = FFI_ALIGN (off, arg_types[i]->alignment);
+	  a = packed + off;
+	  off += arg_types[i]->size;
+	}
       else
-	flags = UNIX64_RET_VOID;
+	a = (const char *) avalue[i];
+
+      plan_load_arg (arg, arg_types[i]->size, reg_args, argp, a);
     }
+  reg_args->rax = UNIX64_NSSE (cif->flags);
+
+  ffi_call_unix64 (stack, cif->bytes + sizeof (struct register_args),
+		   flags, rvalue, fn);
+}
+
+/* Perform a call for a cif without an argument plan, classifying each
+   argument as we go.  The arguments are as for ffi_call_plan.  */
+
+static void
+ffi_call_classify (ffi_cif *cif, void (*fn)(void), int flags, void *rvalue,
+		   void **avalue, void *closure, char *frame)
+{
+  enum x86_64_reg_class classes[MAX_CLASSES];
+  char *stack, *argp;
+  ffi_type **arg_types;
+  int gprcount, ssecount, ngpr, nsse, i, avn;
+  struct register_args *reg_args;
 
   /* Allocate the space for the arguments, plus 4 words of temp space.  */
-  stack = alloca (sizeof (struct register_args) + cif->bytes + 4*8);
+  stack = frame ? frame : alloca (CALL_FRAME_SIZE (cif));
   reg_args = (struct register_args *) stack;
   argp = stack + sizeof (struct register_args);
 
@@ -820,23 +1337,530 @@ ffi_call_int (ffi_cif *cif, void (*fn)(void), void *rvalue,
 		   flags, rvalue, fn);
 }
 
-#ifndef __ILP32__
-extern void
-ffi_call_efi64(ffi_cif *cif, void (*fn)(void), void *rvalue, void **avalue);
-#endif
+/* Make a call, through the plan PLAN if that is not NULL.  */
 
-void
-ffi_call (ffi_cif *cif, void (*fn)(void), void *rvalue, void **avalue)
+static void
+ffi_call_int (ffi_cif *cif, const ffi_x86_64_arg *plan, void (*fn)(void),
+	      void *rvalue, void **avalue, const char *packed, int raw,
+	      void *closure)
 {
-#ifndef __ILP32__
-  if (cif->abi == FFI_EFI64 || cif->abi == FFI_GNUW64)
+  size_t size = CALL_FRAME_SIZE (cif);
+  char *frame;
+  int flags;
+
+  /* Can't call 32-bit mode from 64-bit mode.  */
+  FFI_ASSERT (cif->abi == FFI_UNIX64);
+
+  /* If the return value is a struct and we don't have a return value
+     address then we need to make one.  Otherwise we can ignore it.  */
+  flags = cif->flags;
+  if (rvalue == NULL && (flags & UNIX64_FLAG_RET_IN_MEM))
     {
-      ffi_call_efi64(cif, fn, rvalue, avalue);
-      return;
+      frame = call_frame_acquire (size + FFI_ALIGN (cif->rtype->size, 16));
+      rvalue = frame ? frame + size : alloca (cif->rtype->size);
+    }
+  else
+    {
+      frame = call_frame_acquire (size);
+      if (rvalue == NULL)
+	flags = UNIX64_RET_VOID;
     }
-#endif
-  ffi_call_int (cif, fn, rvalue, avalue, NULL);
-}
+
+  /* Most cifs have a plan of where each argument goes.  */
+  if (plan != NULL)
+    ffi_call_plan (cif, plan, fn, flags, rvalue, avalue, packed, raw,
+		   closure, frame);
+  else
+    ffi_call_classify (cif, fn, flags, rvalue, avalue, closure, frame);
+
+  if (frame != NULL)
+    call_frame_release ();
+}
+
+/* Make the call with the argument area at the top of the SIZE bytes at
+   STACK, so that the callee runs on that memory.  The callee gets at
+   least FFI_CALL_ON_STACK_MIN bytes below the arguments.  */
+
+ffi_status
+ffi_call_on_stack (ffi_cif *cif, void (*fn)(void), void *rvalue,
+		   void **avalue, void *stack, size_t size)
+{
+  size_t need = CALL_FRAME_SIZE (cif);
+  const ffi_x86_64_arg *plan;
+  struct cif_plan p;
+  char *top, *frame;
+  int flags;
+
+  if (cif->abi != FFI_UNIX64)
+    return FFI_BAD_ABI;
+
+  flags = cif->flags;
+  if (rvalue == NULL && (flags & UNIX64_FLAG_RET_IN_MEM))
+    need += FFI_ALIGN (cif->rtype->size, 16);
+  else if (rvalue == NULL)
+    flags = UNIX64_RET_VOID;
+
+  top = (char *) (((uintptr_t) stack + size) & -(uintptr_t) 16);
+  if (top < (char *) stack
+      || (size_t) (top - (char *) stack) < need + FFI_CALL_ON_STACK_MIN)
+    return FFI_BAD_STACK;
+
+  frame = top - need;
+  if (rvalue == NULL && (flags & UNIX64_FLAG_RET_IN_MEM))
+    rvalue = frame + CALL_FRAME_SIZE (cif);
+
+  plan = cif_plan (cif, &p);
+  if (plan != NULL)
+    ffi_call_plan (cif, plan, fn, flags, rvalue, avalue, NULL, RAW_NONE,
+		   NULL, frame);
+  else
+    ffi_call_classify (cif, fn, flags, rvalue, avalue, NULL, frame);
+  return FFI_OK;
+}
+
+/* Calls for cifs with UNIX64_FLAG_SCALAR need only the argument
+   registers, which are loaded from an image by ffi_call_scalar_int, or
+   ffi_call_scalar_sse when any are SSE registers.  Floats travel as
+   the low half of a double's bits.  */
+
+struct scalar_regs
+{
+  UINT64 gpr[MAX_GPR_REGS];
+  UINT64 sse[MAX_SSE_REGS];
+};
+
+typedef struct { UINT64 rax; UINT64 xmm0; } scalar_ret;
+
+extern void ffi_call_scalar_int (struct scalar_regs *regs, void (*fn)(void),
+				 scalar_ret *ret, unsigned nsse) FFI_HIDDEN;
+extern void ffi_call_scalar_sse (struct scalar_regs *regs, void (*fn)(void),
+				 scalar_ret *ret, unsigned nsse) FFI_HIDDEN;
+
+static void
+ffi_call_scalar (ffi_cif *cif, const ffi_x86_64_arg *plan, void (*fn)(void),
+		 void *rvalue, void **avalue)
+{
+  const ffi_x86_64_arg *arg = plan;
+  unsigned nsse = UNIX64_NSSE (cif->flags);
+  struct scalar_regs regs;
+  scalar_ret ret;
+  int i, avn = cif->nargs;
+
+  memset (&regs.gpr, 0, sizeof (regs.gpr));
+  for (i = 0; i < avn; ++i, ++arg)
+    {
+      const char *a = (const char *) avalue[i];
+      UINT64 v = 0;
+
+      switch (arg->op[0])
+	{
+	case UNIX64_ARG_NONE:
+	  continue;
+	case UNIX64_ARG_INT:
+	case UNIX64_ARG_SSE:
+	  memcpy (&v, a, arg->len[0]);
+	  break;
+	case UNIX64_ARG_SINT8:
+	  v = (SINT64) *((const SINT8 *) a);
+	  break;
+	case UNIX64_ARG_SINT16:
+	  v = (SINT64) *((const SINT16 *) a);
+	  break;
+	case UNIX64_ARG_SINT32:
+	  v = (SINT64) *((const SINT32 *) a);
+	  break;
+	default:
+	  abort ();
+	}
+      if (arg->reg[0] < MAX_GPR_REGS)
+	regs.gpr[arg->reg[0]] = v;
+      else
+	regs.sse[(arg->reg[0] - MAX_GPR_REGS) / 2] = v;
+    }
+
+  if (nsse)
+    ffi_call_scalar_sse (&regs, fn, &ret, nsse);
+  else
+    ffi_call_scalar_int (&regs, fn, &ret, 0);
+
+  if (rvalue == NULL)
+    return;
+
+  switch (cif->flags & 0xff)
+    {
+    case UNIX64_RET_VOID:
+      break;
+    case UNIX64_RET_UINT8:
+      *(UINT64 *) rvalue = (UINT8) ret.rax;
+      break;
+    case UNIX64_RET_UINT16:
+      *(UINT64 *) rvalue = (UINT16) ret.rax;
+      break;
+    case UNIX64_RET_UINT32:
+      *(UINT64 *) rvalue = (UINT32) ret.rax;
+      break;
+    case UNIX64_RET_SINT8:
+      *(SINT64 *) rvalue = (SINT8) ret.rax;
+      break;
+    case UNIX64_RET_SINT16:
+      *(SINT64 *) rvalue = (SINT16) ret.rax;
+      break;
+    case UNIX64_RET_SINT32:
+      *(SINT64 *) rvalue = (SINT32) ret.rax;
+      break;
+    case UNIX64_RET_INT64:
+      *(UINT64 *) rvalue = ret.rax;
+      break;
+    case UNIX64_RET_XMM32:
+      memcpy (rvalue, &ret.xmm0, 4);
+      break;
+    case UNIX64_RET_XMM64:
+      memcpy (rvalue, &ret.xmm0, 8);
+      break;
+    default:
+      abort ();
+    }
+}
+
+#ifndef __ILP32__
+extern void
+ffi_call_efi64(ffi_cif *cif, void (*fn)(void), void *rvalue, void **avalue);
+#endif
+
+#if defined (FFI_CALL_TIERING) && FFI_CALL_STUBS
+static int ffi_call_tiered (ffi_cif *cif, struct cif_plan *p,
+			    void (*fn)(void), void *rvalue, void **avalue);
+#endif
+
+void
+ffi_call (ffi_cif *cif, void (*fn)(void), void *rvalue, void **avalue)
+{
+  const ffi_x86_64_arg *plan;
+  struct cif_plan p;
+
+#ifndef __ILP32__
+  if (cif->abi == FFI_EFI64 || cif->abi == FFI_GNUW64)
+    {
+      ffi_call_efi64(cif, fn, rvalue, avalue);
+      return;
+    }
+#endif
+  plan = cif_plan (cif, &p);
+#if defined (FFI_CALL_TIERING) && FFI_CALL_STUBS
+  if (plan != NULL && ffi_call_tiered (cif, &p, fn, rvalue, avalue))
+    return;
+#endif
+  if (plan != NULL && (cif->flags & UNIX64_FLAG_SCALAR))
+    ffi_call_scalar (cif, plan, fn, rvalue, avalue);
+  else
+    ffi_call_int (cif, plan, fn, rvalue, avalue, NULL, RAW_NONE, NULL);
+}
+
+void
+ffi_call_packed (ffi_cif *cif, void (*fn)(void), void *rvalue, void *args)
+{
+  const ffi_x86_64_arg *plan;
+  struct cif_plan p;
+  void **avalue;
+  size_t off = 0;
+  unsigned int i;
+
+  plan = cif_plan (cif, &p);
+  if (plan != NULL)
+    {
+      ffi_call_int (cif, plan, fn, rvalue, NULL, args, RAW_NONE, NULL);
+      return;
+    }
+
+  avalue = alloca (cif->nargs * sizeof (void *));
+  for (i = 0; i < cif->nargs; i++)
+    {
+      off = FFI_ALIGN (off, cif->arg_types[i]->alignment);
+      avalue[i] = (char *) args + off;
+      off += cif->arg_types[i]->size;
+    }
+  ffi_call (cif, fn, rvalue, avalue);
+}
+
+#if FFI_NATIVE_RAW_CALL
+
+/* Raw calls load the argument plan straight from the ffi_raw array,
+   without building an array of pointers to the values first.  */
+
+void
+ffi_raw_call (ffi_cif *cif, void (*fn)(void), void *rvalue, ffi_raw *raw)
+{
+  const ffi_x86_64_arg *plan;
+  struct cif_plan p;
+  void **avalue;
+
+  plan = cif_plan (cif, &p);
+  if (plan != NULL)
+    {
+      ffi_call_int (cif, plan, fn, rvalue, NULL, (const char *) raw,
+		    RAW_PLAIN, NULL);
+      return;
+    }
+
+  avalue = alloca (cif->nargs * sizeof (void *));
+  ffi_raw_to_ptrarray (cif, raw, avalue);
+  ffi_call (cif, fn, rvalue, avalue);
+}
+
+#if FFI_NATIVE_JAVA_RAW_CALL
+
+/* Java values are widened to whole slots, and the return value needs
+   no adjustment on a little-endian target.  */
+
+void
+ffi_java_raw_call (ffi_cif *cif, void (*fn)(void), void *rvalue,
+		   ffi_java_raw *raw)
+{
+  const ffi_x86_64_arg *plan;
+  struct cif_plan p;
+  void **avalue;
+
+  plan = cif_plan (cif, &p);
+  if (plan != NULL)
+    {
+      ffi_call_int (cif, plan, fn, rvalue, NULL, (const char *) raw,
+		    RAW_JAVA, NULL);
+      return;
+    }
+
+  avalue = alloca (cif->nargs * sizeof (void *));
+  ffi_java_raw_to_ptrarray (cif, raw, avalue);
+  ffi_call (cif, fn, rvalue, avalue);
+}
+
+#endif /* FFI_NATIVE_JAVA_RAW_CALL */
+
+#endif /* FFI_NATIVE_RAW_CALL */
+
+void
+ffi_call_batch (ffi_cif *cif, void (*fn)(void), size_t count,
+		void **rvalues, void ***avalues)
+{
+  const ffi_x86_64_arg *plan;
+  struct cif_plan p;
+  void *scratch = NULL;
+  char *frame;
+  size_t k;
+
+  plan = cif_plan (cif, &p);
+  if (plan == NULL)
+    {
+      for (k = 0; k < count; k++)
+	ffi_call (cif, fn, rvalues ? rvalues[k] : NULL, avalues[k]);
+      return;
+    }
+
+  /* Calls without a return address share one scratch return area if
+     the callee needs one, and otherwise discard the value.  */
+  if (cif->flags & UNIX64_FLAG_RET_IN_MEM)
+    scratch = alloca (cif->rtype->size);
+
+  frame = call_frame_acquire (CALL_FRAME_SIZE (cif));
+  for (k = 0; k < count; k++)
+    {
+      void *rvalue = rvalues ? rvalues[k] : NULL;
+      int flags = cif->flags;
+
+      if (rvalue == NULL)
+	{
+	  if (scratch != NULL)
+	    rvalue = scratch;
+	  else
+	    flags = UNIX64_RET_VOID;
+	}
+      ffi_call_plan (cif, plan, fn, flags, rvalue, avalues[k], NULL, RAW_NONE,
+		     NULL, frame);
+    }
+  if (frame != NULL)
+    call_frame_release ();
+}
+
+void
+ffi_call_strided (ffi_cif *cif, void (*fn)(void), size_t count,
+		  void *rvalues, size_t rstride,
+		  void **columns, const size_t *strides)
+{
+  void **avalue = alloca (cif->nargs * sizeof (void *));
+  const ffi_x86_64_arg *plan;
+  struct cif_plan p;
+  char *rvalue = rvalues;
+  void *scratch = NULL;
+  int flags = cif->flags;
+  char *frame;
+  unsigned int i;
+  size_t k;
+
+  for (i = 0; i < cif->nargs; i++)
+    avalue[i] = columns[i];
+  if (rvalue == NULL)
+    rstride = 0;
+
+  plan = cif_plan (cif, &p);
+  if (plan == NULL)
+    {
+      for (k = 0; k < count; k++, rvalue += rstride)
+	{
+	  ffi_call (cif, fn, rvalue, avalue);
+	  for (i = 0; i < cif->nargs; i++)
+	    avalue[i] = (char *) avalue[i] + strides[i];
+	}
+      return;
+    }
+
+  if (rvalue == NULL)
+    {
+      if (flags & UNIX64_FLAG_RET_IN_MEM)
+	scratch = alloca (cif->rtype->size);
+      else
+	flags = UNIX64_RET_VOID;
+    }
+
+  /* Step each argument pointer down its column, rather than building
+     a row of pointers for every call.  */
+  frame = call_frame_acquire (CALL_FRAME_SIZE (cif));
+  for (k = 0; k < count; k++, rvalue += rstride)
+    {
+      ffi_call_plan (cif, plan, fn, flags, scratch ? scratch : rvalue,
+		     avalue, NULL, RAW_NONE, NULL, frame);
+      for (i = 0; i < cif->nargs; i++)
+	avalue[i] = (char *) avalue[i] + strides[i];
+    }
+  if (frame != NULL)
+    call_frame_release ();
+}
+
+/* A call site keeps the register image and stack arguments for one
+   cif and target between calls, so that each argument need only be
+   stored when it changes.  Arguments that the plan splits between
+   registers of different classes, or that must be sign-extended, are
+   kept in VALUES instead and loaded into a copy of the image on every
+   call; FIXUP has a bit set for each of them, and PLAN keeps a copy
+   of the plan to load them by.  Cifs without a plan keep all
+   arguments in VALUES and are called via ffi_call.  */
+
+struct ffi_callsite
+{
+  ffi_cif *cif;
+  void (*fn)(void);
+  unsigned int fixup;
+  struct register_args *image;
+  char *values;
+  void **slot;
+  struct cif_plan plan;
+};
+
+ffi_callsite *
+ffi_callsite_alloc (ffi_cif *cif, void (*fn)(void))
+{
+  ffi_callsite *site;
+  const ffi_x86_64_arg *plan;
+  struct cif_plan p;
+  size_t head, image = 0, off = 0;
+  unsigned int i;
+
+  plan = cif_plan (cif, &p);
+  if (plan)
+    image = FFI_ALIGN (sizeof (struct register_args) + cif->bytes, 16);
+
+  head = FFI_ALIGN (sizeof (*site) + cif->nargs * sizeof (void *), 16);
+  site = calloc (1, head + image + ffi_get_packed_layout (cif, NULL));
+  if (site == NULL)
+    return NULL;
+
+  site->cif = cif;
+  site->fn = fn;
+  site->slot = (void **) (site + 1);
+  site->values = (char *) site + head + image;
+  if (plan)
+    {
+      site->image = (struct register_args *) ((char *) site + head);
+      site->image->rax = UNIX64_NSSE (cif->flags);
+      site->plan = p;
+    }
+
+  for (i = 0; i < cif->nargs; i++)
+    {
+      const ffi_x86_64_arg *arg = &p.args[i];
+
+      off = FFI_ALIGN (off, cif->arg_types[i]->alignment);
+      if (!plan)
+	site->slot[i] = site->values + off;
+      else if (arg->op[0] == UNIX64_ARG_STACK)
+	site->slot[i] = (char *) (site->image + 1) + arg->stack * 8;
+      else if ((arg->op[0] == UNIX64_ARG_INT || arg->op[0] == UNIX64_ARG_SSE)
+	       && (arg->op[1] == UNIX64_ARG_NONE
+		   || arg->reg[1] == arg->reg[0] + 1))
+	site->slot[i] = (UINT64 *) site->image + arg->reg[0];
+      else
+	{
+	  site->slot[i] = site->values + off;
+	  site->fixup |= 1u << i;
+	}
+      off += cif->arg_types[i]->size;
+    }
+
+  return site;
+}
+
+void *
+ffi_callsite_arg (ffi_callsite *site, unsigned int n)
+{
+  return site->slot[n];
+}
+
+void
+ffi_callsite_call (ffi_callsite *site, void *rvalue)
+{
+  ffi_cif *cif = site->cif;
+  struct register_args *reg_args;
+  size_t bytes;
+  char *stack;
+  unsigned int i, fixup;
+  int flags;
+
+  if (site->image == NULL)
+    {
+      ffi_call (cif, site->fn, rvalue, site->slot);
+      return;
+    }
+
+  flags = cif->flags;
+  if (rvalue == NULL)
+    {
+      if (flags & UNIX64_FLAG_RET_IN_MEM)
+	rvalue = alloca (cif->rtype->size);
+      else
+	flags = UNIX64_RET_VOID;
+    }
+
+  /* ffi_call_unix64 runs on the argument area, so the image is copied
+     to the stack rather than used directly.  */
+  bytes = sizeof (struct register_args) + cif->bytes;
+  stack = alloca (bytes + 4*8);
+  memcpy (stack, site->image, bytes);
+  reg_args = (struct register_args *) stack;
+
+  if (flags & UNIX64_FLAG_RET_IN_MEM)
+    reg_args->gpr[0] = (unsigned long) rvalue;
+  for (i = 0, fixup = site->fixup; fixup; i++, fixup >>= 1)
+    if (fixup & 1)
+      plan_load_arg (&site->plan.args[i], cif->arg_types[i]->size,
+		     reg_args, stack + sizeof (struct register_args),
+		     site->slot[i]);
+
+  ffi_call_unix64 (stack, bytes, flags, rvalue, site->fn);
+}
+
+void
+ffi_callsite_free (ffi_callsite *site)
+{
+  free (site);
+}
 
 #ifndef __ILP32__
 extern void
@@ -848,6 +1872,8 @@ void
 ffi_call_go (ffi_cif *cif, void (*fn)(void), void *rvalue,
 	     void **avalue, void *closure)
 {
+  struct cif_plan p;
+
 #ifndef __ILP32__
   if (cif->abi == FFI_EFI64 || cif->abi == FFI_GNUW64)
     {
@@ -855,7 +1881,8 @@ ffi_call_go (ffi_cif *cif, void (*fn)(void), void *rvalue,
       return;
     }
 #endif
-  ffi_call_int (cif, fn, rvalue, avalue, closure);
+  ffi_call_int (cif, cif_plan (cif, &p), fn, rvalue, avalue, NULL, RAW_NONE,
+		closure);
 }
 
 
@@ -911,54 +1938,306 @@ ffi_prep_closure_loc (ffi_closure* closure,
   return FFI_OK;
 }
 
-int FFI_HIDDEN
-ffi_closure_unix64_inner(ffi_cif *cif,
-			 void (*fun)(ffi_cif*, void*, void**, void*),
-			 void *user_data,
-			 void *rvalue,
-			 struct register_args *reg_args,
-			 char *argp)
+#if FFI_FORWARDING_CLOSURES
+
+extern void ffi_forward_unix64(void) FFI_HIDDEN;
+extern int ffi_closure_unix64_inner (ffi_cif *cif,
+				     void (*fun)(ffi_cif*, void*, void**, void*),
+				     void *user_data, void *rvalue,
+				     struct register_args *reg_args,
+				     char *argp) FFI_HIDDEN;
+
+/* ffi_forward_unix64 finds the target and hooks just past the closure.  */
+typedef char ffi_forwarding_closure_check
+  [offsetof (ffi_forwarding_closure, target) == FFI_TRAMPOLINE_SIZE + 24
+   ? 1 : -1];
+
+/* ffi_forward_unix64 keeps the argument registers in a struct
+   register_args.  Once the target returns, the same area holds the
+   return registers: %rax and %rdx as the first two general registers,
+   %xmm0 and %xmm1 as the first two SSE registers, and any x87 values
+   in the 32 bytes that follow.  */
+
+static void
+forward_pre (ffi_cif *cif, void *rvalue, void **avalue,
+	     void *user_data)
 {
-  void **avalue;
-  ffi_type **arg_types;
-  long i, avn;
-  int gprcount, ssecount, ngpr, nsse;
-  int flags;
+  ffi_forwarding_closure *closure = user_data;
 
-  avn = cif->nargs;
-  flags = cif->flags;
-  avalue = alloca(avn * sizeof(void *));
-  gprcount = ssecount = 0;
+  (void) rvalue;
+  closure->pre (cif, avalue, closure->closure.user_data);
+}
 
-  if (flags & UNIX64_FLAG_RET_IN_MEM)
-    {
-      /* On return, %rax will contain the address that was passed
-	 by the caller in %rdi.  */
-      void *r = (void *)(uintptr_t)reg_args->gpr[gprcount++];
-      *(void **)rvalue = r;
-      rvalue = r;
-      flags = (sizeof(void *) == 4 ? UNIX64_RET_UINT32 : UNIX64_RET_INT64);
-    }
+/* Call the pre hook, with the argument registers in REG_ARGS and the
+   stack arguments at ARGP.  The arguments are decoded as for an
+   ordinary closure.  */
 
-  arg_types = cif->arg_types;
-  for (i = 0; i < avn; ++i)
-    {
-      enum x86_64_reg_class classes[MAX_CLASSES];
-      size_t n;
+void FFI_HIDDEN
+ffi_forward_unix64_pre (ffi_forwarding_closure *closure,
+			struct register_args *reg_args, char *argp)
+{
+  void *rvalue;
 
-      n = examine_argument (arg_types[i], classes, 0, &ngpr, &nsse, false);
-      if (n == 0
-	  || gprcount + ngpr > MAX_GPR_REGS
-	  || ssecount + nsse > MAX_SSE_REGS)
-	{
-	  long align = arg_types[i]->alignment;
+  ffi_closure_unix64_inner (closure->closure.cif, forward_pre, closure,
+			    &rvalue, reg_args, argp);
+}
 
-	  /* Stack arguments are *always* at least 8 byte aligned.  */
-	  if (align < 8)
-	    align = 8;
+/* Copy the return value of CIF between the return registers in RET
+   and the value at RVALUE, in the direction given by TO_REGS.  */
 
-	  /* Pass this argument in memory.  */
-	  argp = (void *) FFI_ALIGN (argp, align);
+static void
+forward_ret_copy (ffi_cif *cif, struct register_args *ret, char *rvalue,
+		  int to_regs)
+{
+  char *x87 = (char *) (ret + 1);
+  char *lo = NULL, *hi = NULL;
+  size_t size = cif->rtype->size, split = size;
+  long double st0;
+  UINT64 v;
+  double d;
+
+  switch (cif->flags & 0xff)
+    {
+    /* Integers are widened to a whole ffi_arg, as for ffi_call.  */
+    case UNIX64_RET_UINT8:
+      v = (UINT8) ret->gpr[0];
+      goto int64;
+    case UNIX64_RET_UINT16:
+      v = (UINT16) ret->gpr[0];
+      goto int64;
+    case UNIX64_RET_UINT32:
+      v = (UINT32) ret->gpr[0];
+      goto int64;
+    case UNIX64_RET_SINT8:
+      v = (SINT8) ret->gpr[0];
+      goto int64;
+    case UNIX64_RET_SINT16:
+      v = (SINT16) ret->gpr[0];
+      goto int64;
+    case UNIX64_RET_SINT32:
+      v = (SINT32) ret->gpr[0];
+      goto int64;
+    case UNIX64_RET_INT64:
+      v = ret->gpr[0];
+    int64:
+      if (to_regs)
+	memcpy (&ret->gpr[0], rvalue, 8);
+      else
+	memcpy (rvalue, &v, 8);
+      return;
+    case UNIX64_RET_XMM32:
+    case UNIX64_RET_XMM64:
+    case UNIX64_RET_ST_XMM0:
+      lo = (char *) &ret->sse[0];
+      break;
+    case UNIX64_RET_ST_RAX_RDX:
+      lo = (char *) &ret->gpr[0];
+      break;
+    case UNIX64_RET_X87:
+    case UNIX64_RET_X87_2:
+      lo = x87;
+      break;
+    case UNIX64_RET_ST_XMM0_RAX:
+      lo = (char *) &ret->sse[0];
+      hi = (char *) &ret->gpr[0];
+      split = 8;
+      break;
+    case UNIX64_RET_ST_RAX_XMM0:
+      lo = (char *) &ret->gpr[0];
+      hi = (char *) &ret->sse[0];
+      split = 8;
+      break;
+    case UNIX64_RET_ST_XMM0_XMM1_64:
+      lo = (char *) &ret->sse[0];
+      hi = (char *) &ret->sse[1];
+      split = 8;
+      break;
+    case UNIX64_RET_ST_XMM0_XMM1_128:
+      lo = (char *) &ret->sse[0];
+      hi = (char *) &ret->sse[1];
+      split = 16;
+      break;
+    case UNIX64_RET_X86_ST0:
+      /* Two doubles in %xmm0 and %xmm1, and a third in st(0).  */
+      lo = (char *) &ret->sse[0];
+      hi = (char *) &ret->sse[1];
+      split = 8;
+      size = 16;
+      if (to_regs)
+	{
+	  memcpy (&d, rvalue + 16, 8);
+	  st0 = d;
+	  memcpy (x87, &st0, sizeof (st0));
+	}
+      else
+	{
+	  memcpy (&st0, x87, sizeof (st0));
+	  d = (double) st0;
+	  memcpy (rvalue + 16, &d, 8);
+	}
+      break;
+    default:
+      return;
+    }
+
+  if (split > size)
+    split = size;
+  if (to_regs)
+    {
+      memcpy (lo, rvalue, split);
+      if (hi != NULL)
+	memcpy (hi, rvalue + split, size - split);
+    }
+  else
+    {
+      memcpy (rvalue, lo, split);
+      if (hi != NULL)
+	memcpy (rvalue + split, hi, size - split);
+    }
+}
+
+/* Call the post hook, with the return registers in RET.  The hook sees
+   the return value as ffi_call would store it, and may change it.  */
+
+void FFI_HIDDEN
+ffi_forward_unix64_post (ffi_forwarding_closure *closure,
+			 struct register_args *ret)
+{
+  ffi_cif *cif = closure->closure.cif;
+  union { UINT64 align; char buf[32]; } value;
+
+  /* A value returned in memory is already in place.  */
+  if (cif->flags & UNIX64_FLAG_RET_IN_MEM)
+    {
+      closure->post (cif, (void *) (uintptr_t) ret->gpr[0],
+		     closure->closure.user_data);
+      return;
+    }
+
+  forward_ret_copy (cif, ret, value.buf, 0);
+  closure->post (cif, value.buf, closure->closure.user_data);
+  forward_ret_copy (cif, ret, value.buf, 1);
+}
+
+ffi_status
+ffi_prep_forwarding_closure (ffi_forwarding_closure *closure, ffi_cif *cif,
+			     void (*target)(void),
+			     void (*pre)(ffi_cif *, void **, void *),
+			     void (*post)(ffi_cif *, void *, void *),
+			     void *user_data)
+{
+  static const unsigned char trampoline[16] = {
+    /* leaq  -0x7(%rip),%r10   # 0x0  */
+    0x4c, 0x8d, 0x15, 0xf9, 0xff, 0xff, 0xff,
+    /* jmpq  *0x3(%rip)        # 0x10 */
+    0xff, 0x25, 0x03, 0x00, 0x00, 0x00,
+    /* nopl  (%rax) */
+    0x0f, 0x1f, 0x00
+  };
+  char *tramp = closure->closure.tramp;
+
+  if (cif->abi != FFI_UNIX64)
+    return FFI_BAD_ABI;
+
+  memcpy (tramp, trampoline, sizeof(trampoline));
+  *(UINT64 *)(tramp + 16) = (uintptr_t)ffi_forward_unix64;
+
+  closure->closure.cif = cif;
+  closure->closure.fun = NULL;
+  closure->closure.user_data = user_data;
+  closure->target = target;
+  closure->pre = pre;
+  closure->post = post;
+
+  return FFI_OK;
+}
+
+#endif /* FFI_FORWARDING_CLOSURES */
+
+int FFI_HIDDEN
+ffi_closure_unix64_inner(ffi_cif *cif,
+			 void (*fun)(ffi_cif*, void*, void**, void*),
+			 void *user_data,
+			 void *rvalue,
+			 struct register_args *reg_args,
+			 char *argp)
+{
+  void **avalue;
+  ffi_type **arg_types;
+  const ffi_x86_64_arg *arg;
+  struct cif_plan p;
+  long i, avn;
+  int gprcount, ssecount, ngpr, nsse;
+  int flags;
+
+  avn = cif->nargs;
+  flags = cif->flags;
+  gprcount = ssecount = 0;
+
+  if (flags & UNIX64_FLAG_RET_IN_MEM)
+    {
+      /* On return, %rax will contain the address that was passed
+	 by the caller in %rdi.  */
+      void *r = (void *)(uintptr_t)reg_args->gpr[gprcount++];
+      *(void **)rvalue = r;
+      rvalue = r;
+      flags = (sizeof(void *) == 4 ? UNIX64_RET_UINT32 : UNIX64_RET_INT64);
+    }
+
+  /* With a plan, each argument is either used in place, or gathered
+     from two registers that are not adjacent in REG_ARGS.  Since two
+     general registers are always adjacent, every argument that must
+     be gathered uses at least one SSE register.  */
+  arg = cif_plan (cif, &p);
+  if (arg != NULL)
+    {
+      char *regs = (char *) reg_args;
+      void *plan_avalue[PLAN_ARGS];
+      UINT64 gather[MAX_SSE_REGS][2];
+      int ngather = 0;
+
+      for (i = 0; i < avn; ++i, ++arg)
+	{
+	  if (arg->op[0] == UNIX64_ARG_STACK)
+	    plan_avalue[i] = argp + arg->stack * 8;
+	  else if (arg->op[1] == UNIX64_ARG_NONE
+		   || arg->reg[1] == arg->reg[0] + 1)
+	    plan_avalue[i] = regs + arg->reg[0] * 8;
+	  else
+	    {
+	      UINT64 *g = gather[ngather++];
+
+	      memcpy (&g[0], regs + arg->reg[0] * 8, 8);
+	      memcpy (&g[1], regs + arg->reg[1] * 8, 8);
+	      plan_avalue[i] = g;
+	    }
+	}
+
+      /* Invoke the closure.  */
+      fun (cif, rvalue, plan_avalue, user_data);
+      return flags;
+    }
+
+  avalue = alloca(avn * sizeof(void *));
+  arg_types = cif->arg_types;
+  for (i = 0; i < avn; ++i)
+    {
+      enum x86_64_reg_class classes[MAX_CLASSES];
+      size_t n;
+
+      n = examine_argument (arg_types[i], classes, 0, &ngpr, &nsse, false);
+      if (n == 0
+	  || gprcount + ngpr > MAX_GPR_REGS
+	  || ssecount + nsse > MAX_SSE_REGS)
+	{
+	  long align = arg_types[i]->alignment;
+
+	  /* Stack arguments are *always* at least 8 byte aligned.  */
+	  if (align < 8)
+	    align = 8;
+
+	  /* Pass this argument in memory.  */
+	  argp = (void *) FFI_ALIGN (argp, align);
 	  avalue[i] = argp;
 	  argp += arg_types[i]->size;
 	}
@@ -1004,6 +2283,225 @@ ffi_closure_unix64_inner(ffi_cif *cif,
   return flags;
 }
 
+#if FFI_NATIVE_RAW_CALL
+
+extern void ffi_closure_raw_unix64(void) FFI_HIDDEN;
+extern void ffi_closure_raw_unix64_sse(void) FFI_HIDDEN;
+
+/* Store the argument of TYPE at A in RAW, as ffi_ptrarray_to_raw
+   would, or as ffi_java_ptrarray_to_raw if JAVA, and return the number
+   of slots it takes.  */
+
+static inline size_t
+raw_store_arg (ffi_raw *raw, ffi_type *type, void *a, int java)
+{
+  switch (type->type)
+    {
+    case FFI_TYPE_UINT64:
+    case FFI_TYPE_SINT64:
+    case FFI_TYPE_DOUBLE:
+      raw->uint = *(UINT64 *) a;
+      return java ? 2 : 1;
+    case FFI_TYPE_UINT8:
+      raw->uint = *(UINT8 *) a;
+      return 1;
+    case FFI_TYPE_SINT8:
+      raw->sint = *(SINT8 *) a;
+      return 1;
+    case FFI_TYPE_UINT16:
+      raw->uint = *(UINT16 *) a;
+      return 1;
+    case FFI_TYPE_SINT16:
+      raw->sint = *(SINT16 *) a;
+      return 1;
+    case FFI_TYPE_UINT32:
+      raw->uint = *(UINT32 *) a;
+      return 1;
+    case FFI_TYPE_INT:
+    case FFI_TYPE_SINT32:
+      raw->sint = *(SINT32 *) a;
+      return 1;
+    case FFI_TYPE_POINTER:
+      raw->ptr = *(void **) a;
+      return 1;
+    case FFI_TYPE_STRUCT:
+    case FFI_TYPE_COMPLEX:
+      raw->ptr = a;
+      return 1;
+    default:
+      memcpy (raw->data, a, type->size);
+      return FFI_ALIGN (type->size, FFI_SIZEOF_ARG) / FFI_SIZEOF_ARG;
+    }
+}
+
+/* The generic translations, for cifs without a plan or for other ABIs.
+   The raw entry points also tell the two kinds of closure apart by
+   them.  */
+
+static void
+ffi_translate_raw_args (ffi_cif *cif, void *rvalue, void **avalue,
+			void *user_data)
+{
+  ffi_raw *raw = alloca (ffi_raw_size (cif));
+  ffi_raw_closure *cl = user_data;
+
+  ffi_ptrarray_to_raw (cif, avalue, raw);
+  cl->fun (cif, rvalue, raw, cl->user_data);
+}
+
+#if FFI_NATIVE_JAVA_RAW_CALL
+static void
+ffi_translate_java_raw_args (ffi_cif *cif, void *rvalue, void **avalue,
+			     void *user_data)
+{
+  ffi_java_raw *raw = alloca (ffi_java_raw_size (cif));
+  ffi_java_raw_closure *cl = user_data;
+
+  ffi_java_ptrarray_to_raw (cif, avalue, raw);
+  cl->fun (cif, rvalue, raw, cl->user_data);
+}
+#endif
+
+/* The raw closure entry points call this for cifs with a plan.  The
+   ffi_raw array, or the ffi_java_raw array for a Java closure, is
+   filled straight from the saved registers and the stack arguments.
+   The arguments are as for ffi_closure_unix64_inner, except that the
+   raw CLOSURE gives the function and its data.  */
+
+int FFI_HIDDEN
+ffi_closure_raw_unix64_inner (ffi_cif *cif,
+			      ffi_raw_closure *closure,
+			      void *rvalue,
+			      struct register_args *reg_args,
+			      char *argp)
+{
+  struct cif_plan plan;
+  const ffi_x86_64_arg *arg = cif_plan (cif, &plan);
+  char *regs = (char *) reg_args;
+  UINT64 gather[MAX_SSE_REGS][2];
+  int ngather = 0, flags = cif->flags, java = 0;
+  ffi_raw *raw, *r;
+  unsigned int i;
+
+#if FFI_NATIVE_JAVA_RAW_CALL
+  java = closure->translate_args == ffi_translate_java_raw_args;
+#endif
+
+  if (flags & UNIX64_FLAG_RET_IN_MEM)
+    {
+      void *p = (void *)(uintptr_t)reg_args->gpr[0];
+      *(void **)rvalue = p;
+      rvalue = p;
+      flags = (sizeof(void *) == 4 ? UNIX64_RET_UINT32 : UNIX64_RET_INT64);
+    }
+
+  /* No argument takes more than two slots.  */
+  r = raw = alloca (cif->nargs * 2 * sizeof (ffi_raw));
+  for (i = 0; i < cif->nargs; ++i, ++arg)
+    {
+      void *a;
+
+      if (arg->op[0] == UNIX64_ARG_STACK)
+	a = argp + arg->stack * 8;
+      else if (arg->op[1] == UNIX64_ARG_NONE
+	       || arg->reg[1] == arg->reg[0] + 1)
+	a = regs + arg->reg[0] * 8;
+      else
+	{
+	  UINT64 *g = gather[ngather++];
+
+	  memcpy (&g[0], regs + arg->reg[0] * 8, 8);
+	  memcpy (&g[1], regs + arg->reg[1] * 8, 8);
+	  a = g;
+	}
+      r += raw_store_arg (r, cif->arg_types[i], a, java);
+    }
+
+  closure->fun (cif, rvalue, raw, closure->user_data);
+  return flags;
+}
+
+ffi_status
+ffi_prep_raw_closure_loc (ffi_raw_closure *closure,
+			  ffi_cif *cif,
+			  void (*fun)(ffi_cif*, void*, ffi_raw*, void*),
+			  void *user_data,
+			  void *codeloc)
+{
+  ffi_status status;
+
+  status = ffi_prep_closure_loc ((ffi_closure *) closure, cif,
+				 ffi_translate_raw_args, closure, codeloc);
+  if (status != FFI_OK)
+    return status;
+
+  closure->fun = fun;
+  closure->user_data = user_data;
+
+  /* Send cifs with a plan to the raw entry points instead.  */
+  if (cif->abi == FFI_UNIX64 && (cif->flags & UNIX64_FLAG_ARG_PLAN))
+    {
+      void (*dest)(void);
+
+      if (cif->flags & UNIX64_FLAG_XMM_ARGS)
+	dest = ffi_closure_raw_unix64_sse;
+      else
+	dest = ffi_closure_raw_unix64;
+      *(UINT64 *)(closure->tramp + 16) = (uintptr_t)dest;
+    }
+
+  return FFI_OK;
+}
+
+#if FFI_NATIVE_JAVA_RAW_CALL
+
+/* Java raw closures share the raw entry points; the return value
+   needs no adjustment on a little-endian target.  */
+
+ffi_status
+ffi_prep_java_raw_closure_loc (ffi_java_raw_closure *closure,
+			       ffi_cif *cif,
+			       void (*fun)(ffi_cif*, void*, ffi_java_raw*, void*),
+			       void *user_data,
+			       void *codeloc)
+{
+  ffi_status status;
+
+  status = ffi_prep_closure_loc ((ffi_closure *) closure, cif,
+				 ffi_translate_java_raw_args, closure, codeloc);
+  if (status != FFI_OK)
+    return status;
+
+  closure->fun = fun;
+  closure->user_data = user_data;
+
+  if (cif->abi == FFI_UNIX64 && (cif->flags & UNIX64_FLAG_ARG_PLAN))
+    {
+      void (*dest)(void);
+
+      if (cif->flags & UNIX64_FLAG_XMM_ARGS)
+	dest = ffi_closure_raw_unix64_sse;
+      else
+	dest = ffi_closure_raw_unix64;
+      *(UINT64 *)(closure->tramp + 16) = (uintptr_t)dest;
+    }
+
+  return FFI_OK;
+}
+
+ffi_status
+ffi_prep_java_raw_closure (ffi_java_raw_closure *closure,
+			   ffi_cif *cif,
+			   void (*fun)(ffi_cif*, void*, ffi_java_raw*, void*),
+			   void *user_data)
+{
+  return ffi_prep_java_raw_closure_loc (closure, cif, fun, user_data,
+					closure);
+}
+
+#endif /* FFI_NATIVE_JAVA_RAW_CALL */
+#endif /* FFI_NATIVE_RAW_CALL */
+
 extern void ffi_go_closure_unix64(void) FFI_HIDDEN;
 extern void ffi_go_closure_unix64_sse(void) FFI_HIDDEN;
 
@@ -1033,4 +2531,1383 @@ ffi_prep_go_closure (ffi_go_closure* closure, ffi_cif* cif,
   return FFI_OK;
 }
 
+#if FFI_CALL_STUBS
+
+/* Call stubs are functions generated for one cif, and optionally one
+   target, that load the arguments from AVALUE straight into place
+   using the cif's argument plan, call the target and store the return
+   value.  The generated code is
+
+	push	%rbp
+	mov	%rsp, %rbp
+	push	%rbx
+	push	%r12
+	mov	%rdi, %r12		# or movabs $fn, %r12
+	mov	%rsi, %rbx		# rvalue
+	mov	%rdx, %r10		# avalue
+	sub	$bytes, %rsp
+	<copy stack arguments, then load register arguments>
+	mov	$nsse, %eax
+	call	*%r12
+	<store the return value through %rbx>
+	lea	-16(%rbp), %rsp
+	pop	%r12
+	pop	%rbx
+	pop	%rbp
+	ret
+
+   The stub is preceded by a header holding the writable address that
+   ffi_code_alloc returned, so that it can be freed given only the
+   code address, and the stub's unwind information.  */
+
+#define STUB_HEADER 16
+
+/* Register numbers, as used in instruction encodings.  */
+enum {
+  R_AX, R_CX, R_DX, R_BX, R_SP, R_BP, R_SI, R_DI,
+  R_8, R_9, R_10, R_11, R_12
+};
+
+static const unsigned char stub_gpr[MAX_GPR_REGS] = {
+  R_DI, R_SI, R_DX, R_CX, R_8, R_9
+};
+
+/* Code is emitted twice: once with a NULL BASE to find its size, and
+   once into the allocated memory.  */
+struct stub_buf
+{
+  unsigned char *base;
+  size_t n;
+};
+
+static void
+emit1 (struct stub_buf *b, unsigned int c)
+{
+  if (b->base)
+    b->base[b->n] = (unsigned char) c;
+  b->n++;
+}
+
+static void
+emit32 (struct stub_buf *b, UINT32 v)
+{
+  int i;
+
+  for (i = 0; i < 4; i++, v >>= 8)
+    emit1 (b, v & 0xff);
+}
+
+static void
+emit64 (struct stub_buf *b, UINT64 v)
+{
+  emit32 (b, (UINT32) v);
+  emit32 (b, (UINT32) (v >> 32));
+}
+
+/* Emit the legacy PREFIX (if any), a REX prefix if one is needed, and
+   the one or two byte OPCODE.  */
+static void
+emit_opcode (struct stub_buf *b, int prefix, int w, unsigned int opcode,
+	     int reg, int rm)
+{
+  int rex = (w ? 8 : 0) | (reg & 8 ? 4 : 0) | (rm & 8 ? 1 : 0);
+
+  if (prefix)
+    emit1 (b, prefix);
+  if (rex)
+    emit1 (b, 0x40 | rex);
+  if (opcode > 0xff)
+    emit1 (b, opcode >> 8);
+  emit1 (b, opcode & 0xff);
+}
+
+/* Emit OPCODE with REG and the memory operand DISP(BASE).  */
+static void
+emit_mem (struct stub_buf *b, int prefix, int w, unsigned int opcode,
+	  int reg, int base, int disp)
+{
+  emit_opcode (b, prefix, w, opcode, reg, base);
+  emit1 (b, 0x80 | (reg & 7) << 3 | (base & 7));
+  if ((base & 7) == R_SP)
+    emit1 (b, 0x24);
+  emit32 (b, (UINT32) disp);
+}
+
+/* Emit OPCODE with the register operands REG and RM.  */
+static void
+emit_reg (struct stub_buf *b, int prefix, int w, unsigned int opcode,
+	  int reg, int rm)
+{
+  emit_opcode (b, prefix, w, opcode, reg, rm);
+  emit1 (b, 0xc0 | (reg & 7) << 3 | (rm & 7));
+}
+
+/* Load LEN bytes at DISP(%r11), zero-extended, into general register
+   REG.  Odd sizes are assembled from pieces using %rax.  */
+static void
+emit_load_int (struct stub_buf *b, int reg, int disp, int len)
+{
+  int ofs, piece;
+
+  for (ofs = 0; ofs < len; ofs += piece)
+    {
+      int dst = ofs ? R_AX : reg;
+
+      piece = len - ofs >= 8 ? 8 : len - ofs >= 4 ? 4 : len - ofs >= 2 ? 2 : 1;
+      switch (piece)
+	{
+	case 8:
+	  emit_mem (b, 0, 1, 0x8b, dst, R_11, disp + ofs);	/* mov */
+	  break;
+	case 4:
+	  emit_mem (b, 0, 0, 0x8b, dst, R_11, disp + ofs);	/* mov */
+	  break;
+	case 2:
+	  emit_mem (b, 0, 0, 0x0fb7, dst, R_11, disp + ofs);	/* movzwl */
+	  break;
+	case 1:
+	  emit_mem (b, 0, 0, 0x0fb6, dst, R_11, disp + ofs);	/* movzbl */
+	  break;
+	}
+      if (ofs)
+	{
+	  emit_reg (b, 0, 1, 0xc1, 4, R_AX);	/* shl $ofs*8, %rax */
+	  emit1 (b, ofs * 8);
+	  emit_reg (b, 0, 1, 0x09, R_AX, reg);	/* or %rax, reg */
+	}
+    }
+}
+
+/* Store the low LEN bytes of SRC, a general register or (if XMM) an
+   SSE register, to DISP(%rbx).  */
+static void
+emit_store_part (struct stub_buf *b, int xmm, int src, int disp, int len)
+{
+  if (len == 8)
+    {
+      if (xmm)
+	emit_mem (b, 0xf2, 0, 0x0f11, src, R_BX, disp);	/* movsd */
+      else
+	emit_mem (b, 0, 1, 0x89, src, R_BX, disp);	/* mov */
+      return;
+    }
+
+  if (xmm)
+    emit_reg (b, 0x66, 1, 0x0f7e, src, R_11);	/* movq src, %r11 */
+  else
+    emit_reg (b, 0, 1, 0x89, src, R_11);	/* mov src, %r11 */
+
+  if (len & 4)
+    {
+      emit_mem (b, 0, 0, 0x89, R_11, R_BX, disp);	/* mov %r11d */
+      emit_reg (b, 0, 1, 0xc1, 5, R_11);		/* shr $32, %r11 */
+      emit1 (b, 32);
+      disp += 4;
+    }
+  if (len & 2)
+    {
+      emit_mem (b, 0x66, 0, 0x89, R_11, R_BX, disp);	/* mov %r11w */
+      emit_reg (b, 0, 1, 0xc1, 5, R_11);		/* shr $16, %r11 */
+      emit1 (b, 16);
+      disp += 2;
+    }
+  if (len & 1)
+    emit_mem (b, 0, 0, 0x88, R_11, R_BX, disp);		/* mov %r11b */
+}
+
+/* Copy a stack argument of SIZE bytes from (%r11) to DISP(%rsp).  */
+static void
+emit_copy_stack (struct stub_buf *b, int disp, size_t size)
+{
+  size_t ofs;
+
+  if (size > 64)
+    {
+      emit_mem (b, 0, 1, 0x8d, R_DI, R_SP, disp);	/* lea disp(%rsp), %rdi */
+      emit_reg (b, 0, 1, 0x89, R_11, R_SI);		/* mov %r11, %rsi */
+      emit1 (b, 0xb8 + R_CX);				/* mov $size, %ecx */
+      emit32 (b, (UINT32) size);
+      emit1 (b, 0xf3);					/* rep movsb */
+      emit1 (b, 0xa4);
+      return;
+    }
+
+  for (ofs = 0; ofs + 8 <= size; ofs += 8)
+    {
+      emit_mem (b, 0, 1, 0x8b, R_AX, R_11, ofs);
+      emit_mem (b, 0, 1, 0x89, R_AX, R_SP, disp + ofs);
+    }
+  if (size - ofs >= 4)
+    {
+      emit_mem (b, 0, 0, 0x8b, R_AX, R_11, ofs);
+      emit_mem (b, 0, 0, 0x89, R_AX, R_SP, disp + ofs);
+      ofs += 4;
+    }
+  if (size - ofs >= 2)
+    {
+      emit_mem (b, 0x66, 0, 0x8b, R_AX, R_11, ofs);
+      emit_mem (b, 0x66, 0, 0x89, R_AX, R_SP, disp + ofs);
+      ofs += 2;
+    }
+  if (size - ofs >= 1)
+    {
+      emit_mem (b, 0, 0, 0x8a, R_AX, R_11, ofs);
+      emit_mem (b, 0, 0, 0x88, R_AX, R_SP, disp + ofs);
+    }
+}
+
+/* Load the eightbyte J of the argument at (%r11) as directed by ARG.
+   Return zero if the plan asks for something we cannot encode.  */
+static int
+emit_load_arg (struct stub_buf *b, const ffi_x86_64_arg *arg, int j)
+{
+  int disp = j * 8, len = arg->len[j];
+
+  if (arg->op[j] == UNIX64_ARG_SSE)
+    {
+      int xmm = (arg->reg[j] - REG_ARGS_SSE (0)) / 2;
+
+      if ((arg->reg[j] - REG_ARGS_SSE (0)) % 2 == 0)
+	{
+	  if (len == 8)
+	    emit_mem (b, 0xf2, 0, 0x0f10, xmm, R_11, disp);	/* movsd */
+	  else if (len == 4)
+	    emit_mem (b, 0xf3, 0, 0x0f10, xmm, R_11, disp);	/* movss */
+	  else
+	    return 0;
+	}
+      else
+	{
+	  /* The upper half of the register.  */
+	  if (len == 8)
+	    emit_mem (b, 0x66, 0, 0x0f16, xmm, R_11, disp);	/* movhpd */
+	  else if (len == 4)
+	    {
+	      emit_mem (b, 0xf3, 0, 0x0f10, 8, R_11, disp);	/* movss, %xmm8 */
+	      emit_reg (b, 0, 0, 0x0f16, xmm, 8);		/* movlhps */
+	    }
+	  else
+	    return 0;
+	}
+      return 1;
+    }
+
+  switch (arg->op[j])
+    {
+    case UNIX64_ARG_NONE:
+      break;
+    case UNIX64_ARG_INT:
+      emit_load_int (b, stub_gpr[arg->reg[j]], disp, len);
+      break;
+    case UNIX64_ARG_SINT8:
+      emit_mem (b, 0, 1, 0x0fbe, stub_gpr[arg->reg[j]], R_11, disp);
+      break;
+    case UNIX64_ARG_SINT16:
+      emit_mem (b, 0, 1, 0x0fbf, stub_gpr[arg->reg[j]], R_11, disp);
+      break;
+    case UNIX64_ARG_SINT32:
+      emit_mem (b, 0, 1, 0x63, stub_gpr[arg->reg[j]], R_11, disp);
+      break;
+    default:
+      return 0;
+    }
+  return 1;
+}
+
+/* Store the return value described by FLAGS through %rbx.  */
+static int
+emit_store_return (struct stub_buf *b, unsigned flags)
+{
+  int size = flags >> UNIX64_SIZE_SHIFT;
+  int lo = size < 8 ? size : 8;
+
+  switch (flags & 0xff)
+    {
+    case UNIX64_RET_VOID:
+      break;
+    case UNIX64_RET_UINT8:
+      emit_reg (b, 0, 0, 0x0fb6, R_AX, R_AX);		/* movzbl %al, %eax */
+      goto int64;
+    case UNIX64_RET_UINT16:
+      emit_reg (b, 0, 0, 0x0fb7, R_AX, R_AX);		/* movzwl %ax, %eax */
+      goto int64;
+    case UNIX64_RET_UINT32:
+      emit_reg (b, 0, 0, 0x89, R_AX, R_AX);		/* movl %eax, %eax */
+      goto int64;
+    case UNIX64_RET_SINT8:
+      emit_reg (b, 0, 1, 0x0fbe, R_AX, R_AX);		/* movsbq %al, %rax */
+      goto int64;
+    case UNIX64_RET_SINT16:
+      emit_reg (b, 0, 1, 0x0fbf, R_AX, R_AX);		/* movswq %ax, %rax */
+      goto int64;
+    case UNIX64_RET_SINT32:
+      emit1 (b, 0x48);					/* cltq */
+      emit1 (b, 0x98);
+      /* FALLTHRU */
+    case UNIX64_RET_INT64:
+    int64:
+      emit_mem (b, 0, 1, 0x89, R_AX, R_BX, 0);
+      break;
+    case UNIX64_RET_XMM32:
+      emit_mem (b, 0xf3, 0, 0x0f11, 0, R_BX, 0);	/* movss */
+      break;
+    case UNIX64_RET_XMM64:
+      emit_mem (b, 0xf2, 0, 0x0f11, 0, R_BX, 0);	/* movsd */
+      break;
+    case UNIX64_RET_X87:
+      emit_mem (b, 0, 0, 0xdb, 7, R_BX, 0);		/* fstpt */
+      break;
+    case UNIX64_RET_X87_2:
+      emit_mem (b, 0, 0, 0xdb, 7, R_BX, 0);		/* fstpt */
+      emit_mem (b, 0, 0, 0xdb, 7, R_BX, 16);
+      break;
+    case UNIX64_RET_ST_XMM0_RAX:
+      emit_store_part (b, 1, 0, 0, lo);
+      if (size > 8)
+	emit_store_part (b, 0, R_AX, 8, size - 8);
+      break;
+    case UNIX64_RET_ST_RAX_XMM0:
+      emit_store_part (b, 0, R_AX, 0, lo);
+      if (size > 8)
+	emit_store_part (b, 1, 0, 8, size - 8);
+      break;
+    case UNIX64_RET_ST_XMM0_XMM1_64:
+      emit_store_part (b, 1, 0, 0, lo);
+      if (size > 8)
+	emit_store_part (b, 1, 1, 8, size - 8);
+      break;
+    case UNIX64_RET_ST_XMM0_XMM1_128:
+      emit_mem (b, 0xf3, 0, 0x0f7f, 0, R_BX, 0);	/* movdqu */
+      emit_mem (b, 0xf3, 0, 0x0f7f, 1, R_BX, 16);
+      break;
+    case UNIX64_RET_ST_XMM0:
+      emit_store_part (b, 1, 0, 0, lo);
+      if (size == 16)
+	emit_mem (b, 0x66, 0, 0x0f17, 0, R_BX, 8);	/* movhpd */
+      else if (size > 8)
+	{
+	  emit_reg (b, 0x66, 0, 0x0f6f, 8, 0);		/* movdqa %xmm0, %xmm8 */
+	  emit_reg (b, 0x66, 0, 0x0f73, 3, 8);		/* psrldq $8, %xmm8 */
+	  emit1 (b, 8);
+	  emit_store_part (b, 1, 8, 8, size - 8);
+	}
+      break;
+    case UNIX64_RET_ST_RAX_RDX:
+      emit_store_part (b, 0, R_AX, 0, lo);
+      if (size > 8)
+	emit_store_part (b, 0, R_DX, 8, size - 8);
+      break;
+    case UNIX64_RET_X86_ST0:
+      emit_mem (b, 0, 0, 0xdd, 3, R_BX, 16);		/* fstpl */
+      emit_mem (b, 0xf2, 0, 0x0f11, 1, R_BX, 8);	/* movsd */
+      emit_mem (b, 0xf2, 0, 0x0f11, 0, R_BX, 0);
+      break;
+    default:
+      return 0;
+    }
+  return 1;
+}
+
+/* Emit a call stub for CIF and FN, passing the arguments as PLAN
+   says.  */
+
+static int
+emit_call_stub (struct stub_buf *b, ffi_cif *cif, const ffi_x86_64_arg *plan,
+		void (*fn)(void))
+{
+  const ffi_x86_64_arg *arg;
+  unsigned int i, j, avn = cif->nargs;
+  unsigned bytes = FFI_ALIGN (cif->bytes, 16);
+
+  emit1 (b, 0x50 + R_BP);			/* push %rbp */
+  emit_reg (b, 0, 1, 0x89, R_SP, R_BP);		/* mov %rsp, %rbp */
+  emit1 (b, 0x50 + R_BX);			/* push %rbx */
+  emit1 (b, 0x41);				/* push %r12 */
+  emit1 (b, 0x50 + (R_12 & 7));
+  if (fn)
+    {
+      emit1 (b, 0x49);				/* movabs $fn, %r12 */
+      emit1 (b, 0xb8 + (R_12 & 7));
+      emit64 (b, (uintptr_t) fn);
+    }
+  else
+    emit_reg (b, 0, 1, 0x89, R_DI, R_12);	/* mov %rdi, %r12 */
+  emit_reg (b, 0, 1, 0x89, R_SI, R_BX);		/* mov %rsi, %rbx */
+  emit_reg (b, 0, 1, 0x89, R_DX, R_10);		/* mov %rdx, %r10 */
+  if (bytes)
+    {
+      emit_reg (b, 0, 1, 0x81, 5, R_SP);	/* sub $bytes, %rsp */
+      emit32 (b, bytes);
+    }
+
+  /* Stack arguments first, while the argument registers are free for
+     use by rep movsb.  */
+  for (i = 0, arg = plan; i < avn; i++, arg++)
+    if (arg->op[0] == UNIX64_ARG_STACK)
+      {
+	emit_mem (b, 0, 1, 0x8b, R_11, R_10, i * 8);	/* mov avalue[i], %r11 */
+	emit_copy_stack (b, arg->stack * 8, cif->arg_types[i]->size);
+      }
+
+  for (i = 0, arg = plan; i < avn; i++, arg++)
+    if (arg->op[0] != UNIX64_ARG_STACK)
+      {
+	emit_mem (b, 0, 1, 0x8b, R_11, R_10, i * 8);	/* mov avalue[i], %r11 */
+	for (j = 0; j < 2; j++)
+	  if (!emit_load_arg (b, arg, j))
+	    return 0;
+      }
+
+  if (cif->flags & UNIX64_FLAG_RET_IN_MEM)
+    emit_reg (b, 0, 1, 0x89, R_BX, R_DI);	/* mov %rbx, %rdi */
+  emit1 (b, 0xb8 + R_AX);			/* mov $nsse, %eax */
+  emit32 (b, UNIX64_NSSE (cif->flags));
+  emit_reg (b, 0, 0, 0xff, 2, R_12);		/* call *%r12 */
+
+  if (!emit_store_return (b, cif->flags))
+    return 0;
+
+  emit_mem (b, 0, 1, 0x8d, R_SP, R_BP, -16);	/* lea -16(%rbp), %rsp */
+  emit1 (b, 0x41);				/* pop %r12 */
+  emit1 (b, 0x58 + (R_12 & 7));
+  emit1 (b, 0x58 + R_BX);			/* pop %rbx */
+  emit1 (b, 0x58 + R_BP);			/* pop %rbp */
+  emit1 (b, 0xc3);				/* ret */
+  return 1;
+}
+
+/* Call stubs describe their frame to the unwinder, so that exceptions
+   and backtraces pass through them as through ffi_call.  Every stub
+   has the same prologue and epilogue, so its unwind information is a
+   fixed CIE and FDE, with the stub's address and length filled in.
+   ABI bridges do the same with their own prologues.
+   libgcc registers a whole .eh_frame section, ended by a zero word;
+   the unwinder on Darwin registers a single FDE.  */
+
+extern void __register_frame (void *);
+extern void __deregister_frame (void *);
+
+#define DW_CFA_advance_loc	0x40
+#define DW_CFA_offset		0x80
+#define DW_CFA_advance_loc4	0x04
+#define DW_CFA_def_cfa		0x0c
+#define DW_CFA_def_cfa_register	0x0d
+#define DW_CFA_def_cfa_offset	0x0e
+
+/* DWARF register numbers.  */
+#define DW_RBX	3
+#define DW_RSI	4
+#define DW_RDI	5
+#define DW_RBP	6
+#define DW_RSP	7
+#define DW_R12	12
+#define DW_RA	16
+
+static const unsigned char stub_cie[24] = {
+  20, 0, 0, 0,			/* length */
+  0, 0, 0, 0,			/* CIE id */
+  1, 'z', 'R', 0,		/* version, augmentation */
+  1, 0x78, DW_RA,		/* code and data alignment, return column */
+  1, 0,				/* absolute addresses */
+  DW_CFA_def_cfa, DW_RSP, 8,
+  DW_CFA_offset + DW_RA, 1,
+  0, 0
+};
+
+static const unsigned char stub_fde_cfa[] = {
+  DW_CFA_advance_loc + 1,	/* push %rbp */
+  DW_CFA_def_cfa_offset, 16,
+  DW_CFA_offset + DW_RBP, 2,
+  DW_CFA_advance_loc + 3,	/* mov %rsp, %rbp */
+  DW_CFA_def_cfa_register, DW_RBP,
+  DW_CFA_advance_loc + 1,	/* push %rbx */
+  DW_CFA_offset + DW_RBX, 3,
+  DW_CFA_advance_loc + 2,	/* push %r12 */
+  DW_CFA_offset + DW_R12, 4,
+  DW_CFA_advance_loc4		/* up to the final ret */
+};
+
+#define STUB_FDE	sizeof (stub_cie)
+#define STUB_FDE_CFA	(STUB_FDE + 25)
+#define STUB_PROLOGUE	7
+
+#define stub_register_frame(CODE, SIZE) \
+  code_register_frame (CODE, SIZE, stub_fde_cfa, sizeof (stub_fde_cfa), \
+		       STUB_PROLOGUE)
+
+/* Build and register the unwind information for the SIZE bytes of
+   generated code at CODE.  The code sets up a frame pointer in its
+   first PROLOGUE bytes, as described by the N bytes of CFA, and has
+   its last instruction return after popping %rbp.  */
+static void *
+code_register_frame (void *code, size_t size, const unsigned char *cfa,
+		     size_t n, unsigned prologue)
+{
+  size_t end = FFI_ALIGN (STUB_FDE_CFA + n + 4 + 3, 8);
+  unsigned char *eh = calloc (1, end + 4);
+  unsigned char *p;
+  UINT32 u32;
+  UINT64 u64;
+
+  if (eh == NULL)
+    return NULL;
+
+  memcpy (eh, stub_cie, sizeof (stub_cie));
+  p = eh + STUB_FDE;
+  u32 = end - STUB_FDE - 4;
+  memcpy (p, &u32, 4);				/* length */
+  u32 = STUB_FDE + 4;
+  memcpy (p + 4, &u32, 4);			/* CIE pointer */
+  u64 = (uintptr_t) code;
+  memcpy (p + 8, &u64, 8);			/* initial location */
+  u64 = size;
+  memcpy (p + 16, &u64, 8);			/* address range */
+  p[24] = 0;					/* augmentation length */
+  p = eh + STUB_FDE_CFA;
+  memcpy (p, cfa, n);
+  p += n;
+  u32 = size - 1 - prologue;
+  memcpy (p, &u32, 4);
+  p[4] = DW_CFA_def_cfa;			/* after pop %rbp */
+  p[5] = DW_RSP;
+  p[6] = 8;
+
+#ifdef __APPLE__
+  __register_frame (eh + STUB_FDE);
+#else
+  __register_frame (eh);
+#endif
+  return eh;
+}
+
+static void
+stub_deregister_frame (unsigned char *eh)
+{
+#ifdef __APPLE__
+  __deregister_frame (eh + STUB_FDE);
+#else
+  __deregister_frame (eh);
+#endif
+  free (eh);
+}
+
+ffi_call_stub
+ffi_prep_call_stub (ffi_cif *cif, void (*fn)(void))
+{
+  struct stub_buf b = { NULL, 0 };
+  const ffi_x86_64_arg *plan;
+  struct cif_plan p;
+  void *code, *eh;
+  char *mem;
+
+  plan = cif_plan (cif, &p);
+  if (plan == NULL || !emit_call_stub (&b, cif, plan, fn))
+    return NULL;
+
+  mem = ffi_code_alloc (STUB_HEADER + b.n, &code);
+  if (mem == NULL)
+    return NULL;
+
+  *(void **) mem = mem;
+  b.base = (unsigned char *) mem + STUB_HEADER;
+  b.n = 0;
+  emit_call_stub (&b, cif, plan, fn);
+
+  code = (char *) code + STUB_HEADER;
+  eh = stub_register_frame (code, b.n);
+  if (eh == NULL)
+    {
+      ffi_code_free (mem);
+      return NULL;
+    }
+  ((void **) mem)[1] = eh;
+
+  return (ffi_call_stub) code;
+}
+
+void
+ffi_call_stub_free (ffi_call_stub stub)
+{
+  void **header;
+
+  if (stub == NULL)
+    return;
+  header = (void **) ((char *) stub - STUB_HEADER);
+  stub_deregister_frame (header[1]);
+  ffi_code_free (header[0]);
+}
+
+/* ABI bridges accept a call in one x86-64 calling convention and pass
+   it on to a function that uses the other.  A cif for FFI_UNIX64 gives
+   a bridge for Microsoft x64 callers; a cif for FFI_WIN64 or FFI_GNUW64
+   gives one for SysV callers.  Where each argument comes from and goes
+   to is worked out when the bridge is generated, so a call costs a few
+   register moves and a copy of the stack arguments.  Only integer,
+   pointer, float and double arguments and return values are handled.
+
+   A bridge for Microsoft callers must also preserve %rsi, %rdi and
+   %xmm6-%xmm15, which SysV functions may change:
+
+	push	%rbp
+	mov	%rsp, %rbp
+	push	%rsi
+	push	%rdi
+	sub	$160+stack, %rsp
+	<save %xmm6-%xmm15>
+	<store stack arguments, then move register arguments>
+	mov	$nsse, %eax
+	movabs	$fn, %r11
+	call	*%r11
+	<restore %xmm6-%xmm15>
+	lea	-16(%rbp), %rsp
+	pop	%rdi
+	pop	%rsi
+	pop	%rbp
+	ret
+
+   One for SysV callers only needs to make room for the 32 bytes of
+   "shadow space" that Microsoft functions may use above their return
+   address.  */
+
+#define BRIDGE_SAVE	160
+
+/* The unwind information for each kind of bridge.  The saved SSE
+   registers are left out, as the unwinder only tracks the general
+   registers.  */
+static const unsigned char bridge_ms_fde_cfa[] = {
+  DW_CFA_advance_loc + 1,	/* push %rbp */
+  DW_CFA_def_cfa_offset, 16,
+  DW_CFA_offset + DW_RBP, 2,
+  DW_CFA_advance_loc + 3,	/* mov %rsp, %rbp */
+  DW_CFA_def_cfa_register, DW_RBP,
+  DW_CFA_advance_loc + 1,	/* push %rsi */
+  DW_CFA_offset + DW_RSI, 3,
+  DW_CFA_advance_loc + 1,	/* push %rdi */
+  DW_CFA_offset + DW_RDI, 4,
+  DW_CFA_advance_loc4		/* up to the final ret */
+};
+#define BRIDGE_MS_PROLOGUE	6
+
+static const unsigned char bridge_sysv_fde_cfa[] = {
+  DW_CFA_advance_loc + 1,	/* push %rbp */
+  DW_CFA_def_cfa_offset, 16,
+  DW_CFA_offset + DW_RBP, 2,
+  DW_CFA_advance_loc + 3,	/* mov %rsp, %rbp */
+  DW_CFA_def_cfa_register, DW_RBP,
+  DW_CFA_advance_loc4		/* up to the final ret */
+};
+#define BRIDGE_SYSV_PROLOGUE	4
+
+/* Where an argument is passed.  */
+struct bridge_loc
+{
+  int kind;			/* BRIDGE_GPR, BRIDGE_XMM or BRIDGE_MEM.  */
+  int reg;			/* Register number, or frame offset.  */
+};
+
+enum { BRIDGE_GPR, BRIDGE_XMM, BRIDGE_MEM };
+
+struct bridge_move
+{
+  int src, dst;
+};
+
+static const unsigned char bridge_ms_gpr[4] = { R_CX, R_DX, R_8, R_9 };
+
+/* Return 1 for arguments passed in general registers, 2 for those
+   passed in SSE registers, and 0 for those a bridge cannot handle.  */
+static int
+bridge_class (ffi_type *type)
+{
+  switch (type->type)
+    {
+    case FFI_TYPE_INT:
+    case FFI_TYPE_UINT8:
+    case FFI_TYPE_SINT8:
+    case FFI_TYPE_UINT16:
+    case FFI_TYPE_SINT16:
+    case FFI_TYPE_UINT32:
+    case FFI_TYPE_SINT32:
+    case FFI_TYPE_UINT64:
+    case FFI_TYPE_SINT64:
+    case FFI_TYPE_POINTER:
+      return 1;
+    case FFI_TYPE_FLOAT:
+    case FFI_TYPE_DOUBLE:
+      return 2;
+    default:
+      return 0;
+    }
+}
+
+static void
+emit_bridge_move (struct stub_buf *b, int xmm, int src, int dst)
+{
+  if (xmm)
+    emit_reg (b, 0, 0, 0x0f28, dst, src);	/* movaps src, dst */
+  else
+    emit_reg (b, 0, 1, 0x89, src, dst);		/* mov src, dst */
+}
+
+/* Emit the N register to register moves M, which all take place at
+   once, using SCRATCH to break any cycles.  */
+static void
+emit_bridge_moves (struct stub_buf *b, int xmm, struct bridge_move *m,
+		   int n, int scratch)
+{
+  int i, j;
+
+  while (n > 0)
+    {
+      for (i = 0; i < n; i++)
+	{
+	  for (j = 0; j < n; j++)
+	    if (j != i && m[j].src == m[i].dst)
+	      break;
+	  if (j == n)
+	    break;
+	}
+
+      if (i < n)
+	{
+	  emit_bridge_move (b, xmm, m[i].src, m[i].dst);
+	  m[i] = m[--n];
+	}
+      else
+	{
+	  int src = m[0].src;
+
+	  emit_bridge_move (b, xmm, src, scratch);
+	  for (j = 0; j < n; j++)
+	    if (m[j].src == src)
+	      m[j].src = scratch;
+	}
+    }
+}
+
+/* Sign or zero extend the integer argument of TYPE in REG, since SysV
+   callees may rely on their caller to have done so.  */
+static void
+emit_bridge_extend (struct stub_buf *b, ffi_type *type, int src, int dst)
+{
+  switch (type->type)
+    {
+    case FFI_TYPE_UINT8:
+      emit_reg (b, 0, 1, 0x0fb6, dst, src);	/* movzbq */
+      break;
+    case FFI_TYPE_SINT8:
+      emit_reg (b, 0, 1, 0x0fbe, dst, src);	/* movsbq */
+      break;
+    case FFI_TYPE_UINT16:
+      emit_reg (b, 0, 1, 0x0fb7, dst, src);	/* movzwq */
+      break;
+    case FFI_TYPE_SINT16:
+      emit_reg (b, 0, 1, 0x0fbf, dst, src);	/* movswq */
+      break;
+    case FFI_TYPE_UINT32:
+      emit_reg (b, 0, 0, 0x89, src, dst);	/* mov, 32 bits */
+      break;
+    case FFI_TYPE_INT:
+    case FFI_TYPE_SINT32:
+      emit_reg (b, 0, 1, 0x63, dst, src);	/* movslq */
+      break;
+    default:
+      if (src != dst)
+	emit_reg (b, 0, 1, 0x89, src, dst);	/* mov */
+      break;
+    }
+}
+
+static int
+emit_abi_bridge (struct stub_buf *b, ffi_cif *cif, void (*fn)(void))
+{
+  struct bridge_move gmoves[MAX_GPR_REGS], xmoves[MAX_SSE_REGS];
+  int ms_caller = cif->abi == FFI_UNIX64;
+  unsigned int i, avn = cif->nargs;
+  int ngpr = 0, nsse = 0, nstack = 0, ng = 0, nx = 0;
+  int stack_base, frame;
+  struct bridge_loc *from, *to;
+
+  if (cif->rtype->type != FFI_TYPE_VOID && !bridge_class (cif->rtype))
+    return 0;
+  from = alloca (2 * avn * sizeof (struct bridge_loc));
+  to = from + avn;
+
+  /* Stack arguments start above the saved %rbp and return address, and
+     for Microsoft callers above the shadow space too.  */
+  stack_base = ms_caller ? 16 + 32 : 16;
+
+  for (i = 0; i < avn; i++)
+    {
+      int c = bridge_class (cif->arg_types[i]);
+      struct bridge_loc sysv, ms;
+
+      if (c == 0)
+	return 0;
+
+      /* Microsoft x64 assigns each of the first four arguments the
+	 register for its position.  */
+      if (i < 4)
+	{
+	  ms.kind = c == 1 ? BRIDGE_GPR : BRIDGE_XMM;
+	  ms.reg = c == 1 ? bridge_ms_gpr[i] : (int) i;
+	}
+      else
+	{
+	  ms.kind = BRIDGE_MEM;
+	  ms.reg = 32 + 8 * (i - 4);
+	}
+
+      /* SysV takes registers of each kind in turn.  */
+      if (c == 1 && ngpr < MAX_GPR_REGS)
+	{
+	  sysv.kind = BRIDGE_GPR;
+	  sysv.reg = stub_gpr[ngpr++];
+	}
+      else if (c == 2 && nsse < MAX_SSE_REGS)
+	{
+	  sysv.kind = BRIDGE_XMM;
+	  sysv.reg = nsse++;
+	}
+      else
+	{
+	  sysv.kind = BRIDGE_MEM;
+	  sysv.reg = 8 * nstack++;
+	}
+
+      from[i] = ms_caller ? ms : sysv;
+      to[i] = ms_caller ? sysv : ms;
+      if (from[i].kind == BRIDGE_MEM)
+	from[i].reg += stack_base - (ms_caller ? 32 : 0);
+    }
+
+  /* The outgoing argument area, and for Microsoft callers the save
+     area below %rsi and %rdi.  */
+  frame = ms_caller ? 8 * nstack : 32 + 8 * (int) (avn > 4 ? avn - 4 : 0);
+  frame = FFI_ALIGN (frame, 16);
+  if (ms_caller)
+    frame += BRIDGE_SAVE;
+
+  emit1 (b, 0x50 + R_BP);			/* push %rbp */
+  emit_reg (b, 0, 1, 0x89, R_SP, R_BP);		/* mov %rsp, %rbp */
+  if (ms_caller)
+    {
+      emit1 (b, 0x50 + R_SI);			/* push %rsi */
+      emit1 (b, 0x50 + R_DI);			/* push %rdi */
+    }
+  emit_reg (b, 0, 1, 0x81, 5, R_SP);		/* sub $frame, %rsp */
+  emit32 (b, frame);
+  if (ms_caller)
+    for (i = 6; i < 16; i++)			/* movups %xmmI */
+      emit_mem (b, 0, 0, 0x0f11, i, R_BP, -16 - 16 * (int) (i - 5));
+
+  /* Stack arguments first, while every source register still holds
+     its argument.  */
+  for (i = 0; i < avn; i++)
+    if (to[i].kind == BRIDGE_MEM)
+      {
+	ffi_type *type = cif->arg_types[i];
+
+	if (from[i].kind == BRIDGE_XMM)
+	  emit_mem (b, 0xf2, 0, 0x0f11, from[i].reg, R_SP, to[i].reg);
+	else
+	  {
+	    if (from[i].kind == BRIDGE_MEM)		/* mov, %r11 */
+	      emit_mem (b, 0, 1, 0x8b, R_11, R_BP, from[i].reg);
+	    if (ms_caller && bridge_class (type) == 1)
+	      emit_bridge_extend (b, type, from[i].kind == BRIDGE_MEM
+				  ? R_11 : from[i].reg, R_11);
+	    else if (from[i].kind == BRIDGE_GPR)	/* mov, %r11 */
+	      emit_reg (b, 0, 1, 0x89, from[i].reg, R_11);
+	    emit_mem (b, 0, 1, 0x89, R_11, R_SP, to[i].reg);
+	  }
+      }
+
+  /* Then the moves between registers.  */
+  for (i = 0; i < avn; i++)
+    if (from[i].kind == to[i].kind && from[i].reg != to[i].reg)
+      {
+	struct bridge_move m = { from[i].reg, to[i].reg };
+
+	if (to[i].kind == BRIDGE_GPR)
+	  gmoves[ng++] = m;
+	else if (to[i].kind == BRIDGE_XMM)
+	  xmoves[nx++] = m;
+      }
+  emit_bridge_moves (b, 0, gmoves, ng, R_11);
+  emit_bridge_moves (b, 1, xmoves, nx, 15);
+
+  for (i = 0; i < avn; i++)
+    {
+      ffi_type *type = cif->arg_types[i];
+
+      /* Register arguments that came on the stack.  */
+      if (from[i].kind == BRIDGE_MEM && to[i].kind == BRIDGE_GPR)
+	emit_mem (b, 0, 1, 0x8b, to[i].reg, R_BP, from[i].reg);
+      else if (from[i].kind == BRIDGE_MEM && to[i].kind == BRIDGE_XMM)
+	emit_mem (b, 0xf2, 0, 0x0f10, to[i].reg, R_BP, from[i].reg);
+
+      if (to[i].kind == BRIDGE_GPR && ms_caller)
+	emit_bridge_extend (b, type, to[i].reg, to[i].reg);
+
+      /* Variadic Microsoft functions expect floating point arguments
+	 in the general register for the position as well.  */
+      if (to[i].kind == BRIDGE_XMM && !ms_caller)
+	emit_reg (b, 0x66, 1, 0x0f7e, to[i].reg, bridge_ms_gpr[i]);
+    }
+
+  if (ms_caller)
+    {
+      emit1 (b, 0xb8 + R_AX);			/* mov $nsse, %eax */
+      emit32 (b, nsse);
+    }
+  emit1 (b, 0x49);				/* movabs $fn, %r11 */
+  emit1 (b, 0xb8 + (R_11 & 7));
+  emit64 (b, (uintptr_t) fn);
+  emit_reg (b, 0, 0, 0xff, 2, R_11);		/* call *%r11 */
+
+  if (ms_caller)
+    {
+      for (i = 6; i < 16; i++)			/* movups ..., %xmmI */
+	emit_mem (b, 0, 0, 0x0f10, i, R_BP, -16 - 16 * (int) (i - 5));
+      emit_mem (b, 0, 1, 0x8d, R_SP, R_BP, -16);	/* lea -16(%rbp), %rsp */
+      emit1 (b, 0x58 + R_DI);			/* pop %rdi */
+      emit1 (b, 0x58 + R_SI);			/* pop %rsi */
+      emit1 (b, 0x58 + R_BP);			/* pop %rbp */
+    }
+  else
+    emit1 (b, 0xc9);				/* leave */
+  emit1 (b, 0xc3);				/* ret */
+  return 1;
+}
+
+void *
+ffi_prep_abi_bridge (ffi_cif *cif, void (*fn)(void))
+{
+  struct stub_buf b = { NULL, 0 };
+  void *code, *eh;
+  char *mem;
+
+  if (cif->abi != FFI_UNIX64 && cif->abi != FFI_WIN64
+      && cif->abi != FFI_GNUW64)
+    return NULL;
+  if (!emit_abi_bridge (&b, cif, fn))
+    return NULL;
+
+  mem = ffi_code_alloc (STUB_HEADER + b.n, &code);
+  if (mem == NULL)
+    return NULL;
+
+  *(void **) mem = mem;
+  b.base = (unsigned char *) mem + STUB_HEADER;
+  b.n = 0;
+  emit_abi_bridge (&b, cif, fn);
+
+  code = (char *) code + STUB_HEADER;
+  if (cif->abi == FFI_UNIX64)
+    eh = code_register_frame (code, b.n, bridge_ms_fde_cfa,
+			      sizeof (bridge_ms_fde_cfa), BRIDGE_MS_PROLOGUE);
+  else
+    eh = code_register_frame (code, b.n, bridge_sysv_fde_cfa,
+			      sizeof (bridge_sysv_fde_cfa),
+			      BRIDGE_SYSV_PROLOGUE);
+  if (eh == NULL)
+    {
+      ffi_code_free (mem);
+      return NULL;
+    }
+  ((void **) mem)[1] = eh;
+
+  return code;
+}
+
+void
+ffi_abi_bridge_free (void *bridge)
+{
+  void **header;
+
+  if (bridge == NULL)
+    return;
+  header = (void **) ((char *) bridge - STUB_HEADER);
+  stub_deregister_frame (header[1]);
+  ffi_code_free (header[0]);
+}
+
+/* A bound closure calls a function with some fixed leading arguments,
+   followed by the arguments it was itself called with.  The bound
+   values are built into the code, and the arguments passed in are
+   moved to where the function expects them, so a call through one
+   costs little more than a direct call.  If no arguments are passed
+   on the stack, the closure jumps to the function; otherwise it copies
+   the stack arguments into a frame of its own and calls it.  */
+
+/* Find where the SysV convention passes the arguments of CIF from
+   FIRST on, and return the number of stack slots used, or -1 if some
+   argument is not supported.  */
+static int
+bound_args (ffi_cif *cif, unsigned int first, struct bridge_loc *loc)
+{
+  int ngpr = (cif->flags & UNIX64_FLAG_RET_IN_MEM) != 0;
+  int nsse = 0, nstack = 0;
+  unsigned int i;
+
+  for (i = first; i < cif->nargs; i++)
+    {
+      int c = bridge_class (cif->arg_types[i]);
+      struct bridge_loc *l = &loc[i - first];
+
+      if (c == 0)
+	return -1;
+      if (c == 1 && ngpr < MAX_GPR_REGS)
+	{
+	  l->kind = BRIDGE_GPR;
+	  l->reg = stub_gpr[ngpr++];
+	}
+      else if (c == 2 && nsse < MAX_SSE_REGS)
+	{
+	  l->kind = BRIDGE_XMM;
+	  l->reg = nsse++;
+	}
+      else
+	{
+	  l->kind = BRIDGE_MEM;
+	  l->reg = 8 * nstack++;
+	}
+    }
+  return nstack;
+}
+
+/* Load the 64-bit value V into general register REG.  */
+static void
+emit_load_imm (struct stub_buf *b, int reg, UINT64 v)
+{
+  emit_opcode (b, 0, 1, 0xb8 + (reg & 7), 0, reg);	/* movabs */
+  emit64 (b, v);
+}
+
+/* Emit a bound closure, and set *PFRAME if it has a frame of its own
+   rather than jumping to FN.  */
+static int
+emit_bound_closure (struct stub_buf *b, ffi_cif *cif, void (*fn)(void),
+		    unsigned int nbound, const UINT64 *bound, int *pframe)
+{
+  struct bridge_move gmoves[MAX_GPR_REGS], xmoves[MAX_SSE_REGS];
+  unsigned int i, avn = cif->nargs;
+  int nstack, ng = 0, nx = 0, nsse = 0;
+  struct bridge_loc *from, *to;
+
+  from = alloca (2 * avn * sizeof (struct bridge_loc));
+  to = from + avn;
+  nstack = bound_args (cif, 0, to);
+  if (nstack < 0 || bound_args (cif, nbound, from + nbound) < 0)
+    return 0;
+  *pframe = nstack > 0;
+
+  for (i = 0; i < avn; i++)
+    if (to[i].kind == BRIDGE_XMM)
+      nsse++;
+
+  /* The frame has the same prologue as a bridge for SysV callers.  */
+  if (nstack)
+    {
+      emit1 (b, 0x50 + R_BP);				/* push %rbp */
+      emit_reg (b, 0, 1, 0x89, R_SP, R_BP);		/* mov %rsp, %rbp */
+      emit_reg (b, 0, 1, 0x81, 5, R_SP);		/* sub $frame, %rsp */
+      emit32 (b, FFI_ALIGN (8 * nstack, 16));
+    }
+
+  /* Stack arguments first, while every register still holds the
+     argument passed in it.  */
+  for (i = 0; i < avn; i++)
+    if (to[i].kind == BRIDGE_MEM)
+      {
+	if (i < nbound)
+	  emit_load_imm (b, R_11, bound[i]);
+	else if (from[i].kind == BRIDGE_XMM)		/* movq, %r11 */
+	  emit_reg (b, 0x66, 1, 0x0f7e, from[i].reg, R_11);
+	else if (from[i].kind == BRIDGE_GPR)		/* mov, %r11 */
+	  emit_reg (b, 0, 1, 0x89, from[i].reg, R_11);
+	else						/* mov, %r11 */
+	  emit_mem (b, 0, 1, 0x8b, R_11, R_BP, 16 + from[i].reg);
+	emit_mem (b, 0, 1, 0x89, R_11, R_SP, to[i].reg);
+      }
+
+  /* Arguments passed in registers move up past the bound ones.  */
+  for (i = nbound; i < avn; i++)
+    if (to[i].kind != BRIDGE_MEM && to[i].reg != from[i].reg)
+      {
+	struct bridge_move m = { from[i].reg, to[i].reg };
+
+	if (to[i].kind == BRIDGE_GPR)
+	  gmoves[ng++] = m;
+	else
+	  xmoves[nx++] = m;
+      }
+  emit_bridge_moves (b, 0, gmoves, ng, R_11);
+  emit_bridge_moves (b, 1, xmoves, nx, 15);
+
+  /* Then the bound values.  */
+  for (i = 0; i < nbound; i++)
+    if (to[i].kind == BRIDGE_GPR)
+      emit_load_imm (b, to[i].reg, bound[i]);
+    else if (to[i].kind == BRIDGE_XMM)
+      {
+	emit_load_imm (b, R_11, bound[i]);
+	emit_reg (b, 0x66, 1, 0x0f6e, to[i].reg, R_11);	/* movq %r11, */
+      }
+
+  /* For variadic functions.  */
+  emit1 (b, 0xb8 + R_AX);				/* mov $nsse, %eax */
+  emit32 (b, nsse);
+  emit_load_imm (b, R_11, (uintptr_t) fn);
+  if (nstack)
+    {
+      emit_reg (b, 0, 0, 0xff, 2, R_11);		/* call *%r11 */
+      emit1 (b, 0xc9);					/* leave */
+      emit1 (b, 0xc3);					/* ret */
+    }
+  else
+    emit_reg (b, 0, 0, 0xff, 4, R_11);			/* jmp *%r11 */
+  return 1;
+}
+
+void *
+ffi_prep_bound_closure (ffi_cif *cif, void (*fn)(void),
+			unsigned int nbound, void **values)
+{
+  struct stub_buf b = { NULL, 0 };
+  unsigned int i;
+  UINT64 *bound;
+  void *code, *eh = NULL;
+  char *mem;
+  int frame;
+
+  if (cif->abi != FFI_UNIX64 || nbound > cif->nargs)
+    return NULL;
+  bound = alloca (nbound * sizeof (UINT64));
+
+  /* The bound values are extended to 64 bits as a caller would.  */
+  for (i = 0; i < nbound; i++)
+    {
+      void *v = values[i];
+
+      if (!bridge_class (cif->arg_types[i]))
+	return NULL;
+      switch (cif->arg_types[i]->type)
+	{
+	case FFI_TYPE_UINT8:
+	  bound[i] = *(UINT8 *) v;
+	  break;
+	case FFI_TYPE_SINT8:
+	  bound[i] = (UINT64) (SINT64) *(SINT8 *) v;
+	  break;
+	case FFI_TYPE_UINT16:
+	  bound[i] = *(UINT16 *) v;
+	  break;
+	case FFI_TYPE_SINT16:
+	  bound[i] = (UINT64) (SINT64) *(SINT16 *) v;
+	  break;
+	case FFI_TYPE_UINT32:
+	case FFI_TYPE_FLOAT:
+	  bound[i] = *(UINT32 *) v;
+	  break;
+	case FFI_TYPE_INT:
+	case FFI_TYPE_SINT32:
+	  bound[i] = (UINT64) (SINT64) *(SINT32 *) v;
+	  break;
+	case FFI_TYPE_POINTER:
+	  bound[i] = (uintptr_t) *(void **) v;
+	  break;
+	default:
+	  bound[i] = *(UINT64 *) v;
+	  break;
+	}
+    }
+
+  if (!emit_bound_closure (&b, cif, fn, nbound, bound, &frame))
+    return NULL;
+
+  mem = ffi_code_alloc (STUB_HEADER + b.n, &code);
+  if (mem == NULL)
+    return NULL;
+
+  *(void **) mem = mem;
+  b.base = (unsigned char *) mem + STUB_HEADER;
+  b.n = 0;
+  emit_bound_closure (&b, cif, fn, nbound, bound, &frame);
+
+  /* A closure that jumps to FN is never on the stack while it runs, so
+     only one with a frame needs unwind information.  */
+  code = (char *) code + STUB_HEADER;
+  if (frame)
+    {
+      eh = code_register_frame (code, b.n, bridge_sysv_fde_cfa,
+				sizeof (bridge_sysv_fde_cfa),
+				BRIDGE_SYSV_PROLOGUE);
+      if (eh == NULL)
+	{
+	  ffi_code_free (mem);
+	  return NULL;
+	}
+    }
+  ((void **) mem)[1] = eh;
+
+  return code;
+}
+
+void
+ffi_bound_closure_free (void *closure)
+{
+  void **header;
+
+  if (closure == NULL)
+    return;
+  header = (void **) ((char *) closure - STUB_HEADER);
+  if (header[1] != NULL)
+    stub_deregister_frame (header[1]);
+  ffi_code_free (header[0]);
+}
+
+#ifdef FFI_CALL_TIERING
+
+/* Once ffi_call has made CALL_TIER_THRESHOLD calls through a cif, it
+   switches the cif to an unbound call stub.  The count and the stub
+   are kept in the plan table, so a cif that loses its slot starts
+   counting again.  Stubs are shared by all cifs with the same plan,
+   since a cif has no destructor that could free its own, and are
+   never freed.  The count is kept without atomic read-modify-write
+   operations: a lost update only delays the switch.  Setting LIBFFI_NO_CALL_TIERING in the environment disables
+   the switch, for systems that forbid generating code at run time.  */
+
+#include <pthread.h>
+
+#define CALL_TIER_THRESHOLD	1000
+
+struct call_tier
+{
+  struct call_tier *next;
+  void *stub;
+  unsigned flags, bytes, nargs;
+  ffi_x86_64_arg args[PLAN_ARGS];
+  size_t size[PLAN_ARGS];
+};
+
+static pthread_mutex_t call_tier_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct call_tier *call_tiers;
+static int call_tier_disabled = -1;
+
+/* Stored for a cif whose stub could not be made.  */
+static char call_tier_none;
+
+/* Record STUB for CIF in the plan table, if CIF still has its slot.  */
+
+static void
+plan_set_stub (ffi_cif *cif, void *stub)
+{
+  struct plan_slot *s = PLAN_SLOT (cif);
+  unsigned seq;
+
+  if (!plan_slot_lock (s, &seq))
+    return;
+  if (plan_matches (s, cif))
+    s->plan.stub = stub;
+  plan_slot_unlock (s, seq);
+}
+
+static void
+call_tier_key (struct call_tier *key, ffi_cif *cif,
+	       const ffi_x86_64_arg *plan)
+{
+  unsigned int i;
+
+  memset (key, 0, sizeof (*key));
+  key->flags = cif->flags;
+  key->bytes = cif->bytes;
+  key->nargs = cif->nargs;
+  memcpy (key->args, plan, cif->nargs * sizeof (ffi_x86_64_arg));
+  for (i = 0; i < cif->nargs; i++)
+    if (plan[i].op[0] == UNIX64_ARG_STACK)
+      key->size[i] = cif->arg_types[i]->size;
+}
+
+static void *
+call_tier_up (ffi_cif *cif, const ffi_x86_64_arg *plan)
+{
+  struct call_tier key, *t;
+  void *stub;
+
+  call_tier_key (&key, cif, plan);
+
+  pthread_mutex_lock (&call_tier_lock);
+  if (call_tier_disabled < 0)
+    call_tier_disabled = getenv ("LIBFFI_NO_CALL_TIERING") != NULL;
+
+  stub = &call_tier_none;
+  if (call_tier_disabled)
+    goto publish;
+
+  for (t = call_tiers; t != NULL; t = t->next)
+    if (memcmp (&t->flags, &key.flags,
+		sizeof (key) - offsetof (struct call_tier, flags)) == 0)
+      break;
+
+  if (t == NULL)
+    {
+      ffi_call_stub s = ffi_prep_call_stub (cif, NULL);
+
+      if (s == NULL)
+	goto publish;
+      t = malloc (sizeof (*t));
+      if (t == NULL)
+	{
+	  ffi_call_stub_free (s);
+	  goto publish;
+	}
+      memcpy (t, &key, sizeof (*t));
+      t->stub = (void *) s;
+      t->next = call_tiers;
+      call_tiers = t;
+    }
+  stub = t->stub;
+
+ publish:
+  pthread_mutex_unlock (&call_tier_lock);
+  plan_set_stub (cif, stub);
+  return stub;
+}
+
+/* Make the call through CIF's stub, switching to one first if CIF has
+   become hot.  P is the plan of CIF, as looked up by ffi_call.  Return
+   0 if the caller must make the call itself.  */
+
+static int
+ffi_call_tiered (ffi_cif *cif, struct cif_plan *p, void (*fn)(void),
+		 void *rvalue, void **avalue)
+{
+  void *stub = p->stub;
+  unsigned *calls, n;
+
+  if (stub == NULL)
+    {
+      calls = &PLAN_SLOT (cif)->calls;
+      n = __atomic_load_n (calls, __ATOMIC_RELAXED) + 1;
+      __atomic_store_n (calls, n, __ATOMIC_RELAXED);
+      if (n < CALL_TIER_THRESHOLD)
+	return 0;
+      stub = call_tier_up (cif, p->args);
+    }
+
+  /* The stub stores the return value unconditionally.  */
+  if (stub == &call_tier_none
+      || (rvalue == NULL && cif->rtype->type != FFI_TYPE_VOID))
+    return 0;
+
+  ((ffi_call_stub) stub) (fn, rvalue, avalue);
+  return 1;
+}
+
+#endif /* FFI_CALL_TIERING */
+
+#endif /* FFI_CALL_STUBS */
+
 #endif /* __x86_64__ */
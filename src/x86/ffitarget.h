@@ -54,6 +54,30 @@
 #define FFI_TARGET_HAS_COMPLEX_TYPE
 #endif
 
+#if defined (X86_64) || (defined (__x86_64__) && defined (X86_DARWIN))
+
+/* Packed argument buffers are loaded straight from the plan, batches
+   of calls share the per-cif setup, call sites keep arguments in the
+   register image, and calls can run on a stack given by the caller.
+   Raw calls and closures convert between the ffi_raw array and the
+   registers directly, keeping the generic ffi_raw_closure layout.  */
+#define FFI_NATIVE_PACKED_CALL 1
+#define FFI_NATIVE_BATCH_CALL 1
+#define FFI_NATIVE_CALLSITE 1
+#define FFI_NATIVE_CALL_ON_STACK 1
+#define FFI_NATIVE_RAW_CALL 1
+
+/* Call stubs specialized to one cif are generated from the plan, and
+   forwarding closures pass their arguments on without decoding them.
+   Java raw calls and closures use the raw path where ffi_java_raw is
+   ffi_raw.  */
+#ifndef __ILP32__
+#define FFI_CALL_STUBS 1
+#define FFI_FORWARDING_CLOSURES 1
+#define FFI_NATIVE_JAVA_RAW_CALL 1
+#endif
+#endif
+
 /* ---- Generic type definitions ----------------------------------------- */
 
 #ifndef LIBFFI_ASM
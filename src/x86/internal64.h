@@ -22,9 +22,34 @@
 
 #define UNIX64_RET_LAST        18
 
+#define UNIX64_FLAG_ARG_PLAN    (1 << 8)
+#define UNIX64_FLAG_SCALAR      (1 << 9)
 #define UNIX64_FLAG_RET_IN_MEM    (1 << 10)
 #define UNIX64_FLAG_XMM_ARGS    (1 << 11)
-#define UNIX64_SIZE_SHIFT    12
+
+/* The flags also hold the number of SSE registers taken by the
+   arguments, and the size of a structure returned in registers.  */
+#define UNIX64_NSSE_SHIFT    12
+#define UNIX64_NSSE_MASK     15
+#define UNIX64_SIZE_SHIFT    16
+
+/* Offsets within ffi_cif, for the closure entry points.  */
+#ifdef __ILP32__
+#define UNIX64_CIF_BYTES   16
+#define UNIX64_CIF_FLAGS   20
+#else
+#define UNIX64_CIF_BYTES   24
+#define UNIX64_CIF_FLAGS   28
+#endif
+
+/* Operations recorded in the per-argument plan, ffi_x86_64_arg.  */
+#define UNIX64_ARG_NONE     0	/* Eightbyte is not passed.  */
+#define UNIX64_ARG_INT      1	/* Zero-extended into a general register.  */
+#define UNIX64_ARG_SINT8    2	/* Sign-extended into a general register.  */
+#define UNIX64_ARG_SINT16   3
+#define UNIX64_ARG_SINT32   4
+#define UNIX64_ARG_SSE      5	/* Copied into an SSE register.  */
+#define UNIX64_ARG_STACK    6	/* Whole argument is passed in memory.  */
 
 
 #endif
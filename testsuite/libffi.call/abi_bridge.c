@@ -0,0 +1,118 @@
+/* Area:	ffi_prep_abi_bridge, ffi_abi_bridge_free
+   Purpose:	Check bridges between the SysV and Microsoft x64 calling
+		conventions.
+   Limitations:	none.
+   PR:		none.
+   Originator:	none.  */
+
+/* { dg-do run } */
+#include "ffitest.h"
+
+#if FFI_CALL_STUBS
+
+#define MIX_ARGS							\
+  signed char c, double a, long b, float f, unsigned short s, double d,	\
+  int e, long g, long h, double i, double j, double k, double l,	\
+  double m, double n, long o
+
+#define MIX_BODY							\
+  return c + a * 2 + b * 3 + f * 4 + s * 5 + d * 6 + e * 7 + g * 8	\
+    + h * 9 + i * 10 + j * 11 + k * 12 + l * 13 + m * 14 + n * 15	\
+    + o * 16
+
+#define MIX_VALUES							\
+  -3, 1.5, -100000000000L, 0.25f, 65535, 2.5, -7, 8, 9, 10.5, 11.5,	\
+  12.5, 13.5, 14.5, 15.5, 16
+
+static double mix (MIX_ARGS) { MIX_BODY; }
+static double __MSABI__ ms_mix (MIX_ARGS) { MIX_BODY; }
+
+static long sub (long a, long b) { return a - b; }
+static long __MSABI__ ms_sub (long a, long b) { return a - b; }
+
+static int calls;
+static void touch (void) { calls++; }
+
+typedef double (*mix_fn) (MIX_ARGS);
+typedef double (__MSABI__ *ms_mix_fn) (MIX_ARGS);
+typedef long (*sub_fn) (long, long);
+typedef long (__MSABI__ *ms_sub_fn) (long, long);
+typedef void (__MSABI__ *ms_void_fn) (void);
+
+int main (void)
+{
+  ffi_cif cif, ms_cif, void_cif, sub_cif, ms_sub_cif, bad_cif;
+  ffi_type *args[16], *bad_args[1];
+  void *to_sysv, *to_ms, *round_trip, *to_void, *b1, *b2;
+  double expect = mix (MIX_VALUES);
+
+  args[0] = &ffi_type_schar;
+  args[1] = &ffi_type_double;
+  args[2] = &ffi_type_slong;
+  args[3] = &ffi_type_float;
+  args[4] = &ffi_type_ushort;
+  args[5] = &ffi_type_double;
+  args[6] = &ffi_type_sint;
+  args[7] = &ffi_type_slong;
+  args[8] = &ffi_type_slong;
+  args[9] = &ffi_type_double;
+  args[10] = &ffi_type_double;
+  args[11] = &ffi_type_double;
+  args[12] = &ffi_type_double;
+  args[13] = &ffi_type_double;
+  args[14] = &ffi_type_double;
+  args[15] = &ffi_type_slong;
+  CHECK(ffi_prep_cif(&cif, FFI_UNIX64, 16, &ffi_type_double, args) == FFI_OK);
+  CHECK(ffi_prep_cif(&ms_cif, FFI_WIN64, 16, &ffi_type_double, args) == FFI_OK);
+
+  /* Microsoft callers, SysV callee.  */
+  to_sysv = ffi_prep_abi_bridge (&cif, FFI_FN(mix));
+  CHECK(to_sysv != NULL);
+  CHECK(((ms_mix_fn) to_sysv) (MIX_VALUES) == expect);
+
+  /* SysV callers, Microsoft callee.  */
+  to_ms = ffi_prep_abi_bridge (&ms_cif, FFI_FN(ms_mix));
+  CHECK(to_ms != NULL);
+  CHECK(((mix_fn) to_ms) (MIX_VALUES) == expect);
+
+  /* Both ways, back to where we started.  */
+  round_trip = ffi_prep_abi_bridge (&ms_cif, FFI_FN(to_sysv));
+  CHECK(round_trip != NULL);
+  CHECK(((mix_fn) round_trip) (MIX_VALUES) == expect);
+
+  CHECK(ffi_prep_cif(&void_cif, FFI_UNIX64, 0, &ffi_type_void, NULL) == FFI_OK);
+  to_void = ffi_prep_abi_bridge (&void_cif, FFI_FN(touch));
+  CHECK(to_void != NULL);
+  ((ms_void_fn) to_void) ();
+  CHECK(calls == 1);
+
+  CHECK(ffi_prep_cif(&sub_cif, FFI_UNIX64, 2, &ffi_type_slong, args + 7) == FFI_OK);
+  CHECK(ffi_prep_cif(&ms_sub_cif, FFI_GNUW64, 2, &ffi_type_slong, args + 7) == FFI_OK);
+  b1 = ffi_prep_abi_bridge (&sub_cif, FFI_FN(sub));
+  b2 = ffi_prep_abi_bridge (&ms_sub_cif, FFI_FN(ms_sub));
+  CHECK(b1 != NULL && b2 != NULL);
+  CHECK(((ms_sub_fn) b1) (10, 3) == 7);
+  CHECK(((sub_fn) b2) (10, 3) == 7);
+
+  /* Nor are other types, such as long double.  */
+  bad_args[0] = &ffi_type_longdouble;
+  CHECK(ffi_prep_cif(&bad_cif, FFI_UNIX64, 1, &ffi_type_void, bad_args) == FFI_OK);
+  CHECK(ffi_prep_abi_bridge (&bad_cif, FFI_FN(touch)) == NULL);
+
+  ffi_abi_bridge_free (round_trip);
+  ffi_abi_bridge_free (to_ms);
+  ffi_abi_bridge_free (to_sysv);
+  ffi_abi_bridge_free (to_void);
+  ffi_abi_bridge_free (b1);
+  ffi_abi_bridge_free (b2);
+  exit(0);
+}
+
+#else
+
+int main (void)
+{
+  exit(0);
+}
+
+#endif
@@ -0,0 +1,115 @@
+/* Area:	ffi_call_async, ffi_async_poll, ffi_async_wait
+   Purpose:	Check calls run on worker threads.
+   Limitations:	none.
+   PR:		none.
+   Originator:	none.  */
+
+/* { dg-do run } */
+#include "ffitest.h"
+
+#if FFI_ASYNC_CALLS
+
+#define CALLS 500
+#define CAPACITY 16
+
+typedef struct { long a, b, c; } three_longs;
+
+static long
+weigh (three_longs t, double f, signed char c)
+{
+  return (long) ((t.a + 2 * t.b + 3 * t.c) * f) + c;
+}
+
+int main (void)
+{
+  ffi_async_queue *q;
+  ffi_cif cif;
+  ffi_type *args[MAX_ARGS];
+  void *values[MAX_ARGS];
+  ffi_type three_type;
+  ffi_type *three_elements[4];
+  static ffi_arg results[CALLS];
+  static char seen[CALLS];
+  three_longs t;
+  double f;
+  signed char c;
+  void *user_data;
+  long i, submitted = 0, completed = 0;
+
+  three_type.size = three_type.alignment = 0;
+  three_type.type = FFI_TYPE_STRUCT;
+  three_type.elements = three_elements;
+  three_elements[0] = three_elements[1] = three_elements[2] = &ffi_type_slong;
+  three_elements[3] = NULL;
+
+  args[0] = &three_type;
+  args[1] = &ffi_type_double;
+  args[2] = &ffi_type_schar;
+  values[0] = &t;
+  values[1] = &f;
+  values[2] = &c;
+  CHECK(ffi_prep_cif(&cif, FFI_DEFAULT_ABI, 3, &ffi_type_slong, args) == FFI_OK);
+
+  CHECK(ffi_async_queue_alloc (0, CAPACITY) == NULL);
+  q = ffi_async_queue_alloc (4, CAPACITY);
+  CHECK(q != NULL);
+
+  /* Nothing is outstanding yet.  */
+  CHECK(ffi_async_poll (q, &user_data) == 0);
+  CHECK(ffi_async_wait (q, &user_data) == 0);
+
+  while (completed < CALLS)
+    {
+      /* The arguments are copied, so they may change at once.  */
+      while (submitted < CALLS)
+	{
+	  t.a = submitted;
+	  t.b = submitted + 1;
+	  t.c = -submitted;
+	  f = (submitted & 1) ? 0.5 : 2.0;
+	  c = (signed char) (submitted & 0x7f);
+	  if (!ffi_call_async (q, &cif, FFI_FN(weigh), &results[submitted],
+			       values, (void *) submitted))
+	    break;
+	  submitted++;
+	}
+
+      CHECK(ffi_async_wait (q, &user_data) == 1);
+      do
+	{
+	  i = (long) user_data;
+	  CHECK(i >= 0 && i < submitted && !seen[i]);
+	  seen[i] = 1;
+	  completed++;
+	}
+      while (ffi_async_poll (q, &user_data));
+    }
+
+  CHECK(ffi_async_poll (q, &user_data) == 0);
+  CHECK(ffi_async_wait (q, &user_data) == 0);
+
+  for (i = 0; i < CALLS; i++)
+    {
+      three_longs e = { i, i + 1, -i };
+
+      CHECK((long) results[i]
+	    == weigh (e, (i & 1) ? 0.5 : 2.0, (signed char) (i & 0x7f)));
+    }
+
+  /* Calls still queued are made before the pool stops.  */
+  for (i = 0; i < CAPACITY; i++)
+    CHECK(ffi_call_async (q, &cif, FFI_FN(weigh), &results[i], values, NULL));
+  CHECK(!ffi_call_async (q, &cif, FFI_FN(weigh), &results[0], values, NULL));
+  ffi_async_queue_free (q);
+
+  exit(0);
+}
+
+#else
+
+int main (void)
+{
+  exit(0);
+}
+
+#endif
@@ -0,0 +1,100 @@
+/* Area:	ffi_call_batch
+   Purpose:	Check repeated calls through one cif.
+   Limitations:	none.
+   PR:		none.
+   Originator:	none.  */
+
+/* { dg-do run } */
+#include "ffitest.h"
+
+#define ROWS 1000
+
+typedef struct { long a, b, c, d; } big_struct;
+
+static long calls;
+
+static long
+scale (long x, double f)
+{
+  calls++;
+  return (long) (x * f);
+}
+
+static big_struct
+spread (int x)
+{
+  big_struct r = { x, x * 2, x * 3, x * 4 };
+  calls++;
+  return r;
+}
+
+int main (void)
+{
+  ffi_cif cif;
+  ffi_type *args[MAX_ARGS];
+  ffi_type big_type;
+  ffi_type *big_elements[5];
+  static long xs[ROWS];
+  static double fs[ROWS];
+  static int is[ROWS];
+  static ffi_arg results[ROWS];
+  static big_struct bigs[ROWS];
+  static void *avalue_rows[ROWS][2];
+  static void **avalues[ROWS];
+  static void *rvalues[ROWS];
+  int i;
+
+  args[0] = &ffi_type_slong;
+  args[1] = &ffi_type_double;
+  CHECK(ffi_prep_cif(&cif, FFI_DEFAULT_ABI, 2, &ffi_type_slong, args) == FFI_OK);
+
+  for (i = 0; i < ROWS; i++)
+    {
+      xs[i] = i;
+      fs[i] = (i & 1) ? 3.0 : -2.0;
+      avalue_rows[i][0] = &xs[i];
+      avalue_rows[i][1] = &fs[i];
+      avalues[i] = avalue_rows[i];
+      rvalues[i] = &results[i];
+    }
+
+  ffi_call_batch (&cif, FFI_FN(scale), ROWS, rvalues, avalues);
+  for (i = 0; i < ROWS; i++)
+    CHECK((long) results[i] == i * ((i & 1) ? 3 : -2));
+  CHECK(calls == ROWS);
+
+  /* Results may be discarded, for all rows or for some.  */
+  calls = 0;
+  ffi_call_batch (&cif, FFI_FN(scale), ROWS, NULL, avalues);
+  CHECK(calls == ROWS);
+
+  /* Structures returned in memory.  */
+  big_type.size = big_type.alignment = 0;
+  big_type.type = FFI_TYPE_STRUCT;
+  big_type.elements = big_elements;
+  for (i = 0; i < 4; i++)
+    big_elements[i] = &ffi_type_slong;
+  big_elements[4] = NULL;
+
+  args[0] = &ffi_type_sint;
+  CHECK(ffi_prep_cif(&cif, FFI_DEFAULT_ABI, 1, &big_type, args) == FFI_OK);
+
+  for (i = 0; i < ROWS; i++)
+    {
+      is[i] = i;
+      avalue_rows[i][0] = &is[i];
+      rvalues[i] = (i % 3) ? &bigs[i] : NULL;
+    }
+
+  calls = 0;
+  ffi_call_batch (&cif, FFI_FN(spread), ROWS, rvalues, avalues);
+  CHECK(calls == ROWS);
+  for (i = 0; i < ROWS; i++)
+    if (i % 3)
+      CHECK(bigs[i].a == i && bigs[i].b == 2 * i
+	    && bigs[i].c == 3 * i && bigs[i].d == 4 * i);
+    else
+      CHECK(bigs[i].a == 0 && bigs[i].d == 0);
+
+  exit(0);
+}
@@ -0,0 +1,70 @@
+/* Area:	ffi_call
+   Purpose:	Check that a call left by longjmp does not keep later
+		calls from reusing the same argument area.
+   Limitations:	none.
+   PR:		none.
+   Originator:	none.  */
+
+/* { dg-do run } */
+#include "ffitest.h"
+#include <setjmp.h>
+
+static jmp_buf env;
+static volatile char *seen;
+
+/* Seven arguments, so that one is passed on the stack.  */
+
+static int
+add_one (int a, int b, int c, int d, int e, int f, int n)
+{
+  volatile char x = 0;
+
+  seen = &x;
+  return a + b + c + d + e + f + n + x + 1;
+}
+
+static int
+jump (int a, int b, int c, int d, int e, int f, int n)
+{
+  volatile char x = 0;
+
+  seen = &x;
+  longjmp (env, a + b + c + d + e + f + n + x);
+}
+
+int main (void)
+{
+  ffi_cif cif;
+  ffi_type *args[7];
+  void *values[7];
+  volatile char *first;
+  ffi_arg r;
+  int zero = 0, n = 41, i;
+
+  for (i = 0; i < 7; i++)
+    {
+      args[i] = &ffi_type_sint;
+      values[i] = i < 6 ? &zero : &n;
+    }
+  CHECK(ffi_prep_cif(&cif, FFI_DEFAULT_ABI, 7, &ffi_type_sint, args) == FFI_OK);
+
+  ffi_call(&cif, FFI_FN(add_one), &r, values);
+  CHECK((int) r == 42);
+  first = seen;
+
+  /* With --enable-heap-call-frames, every call from here runs on the
+     same frame, so the callee's locals land at the same address.  */
+  for (i = 0; i < 3; i++)
+    {
+      if (setjmp (env) == 0)
+	{
+	  ffi_call(&cif, FFI_FN(jump), &r, values);
+	  CHECK(0);
+	}
+
+      ffi_call(&cif, FFI_FN(add_one), &r, values);
+      CHECK((int) r == 42);
+      CHECK(seen == first);
+    }
+  exit(0);
+}
@@ -0,0 +1,92 @@
+/* Area:	ffi_call
+   Purpose:	Check that calls stay correct when a cif is used often.
+   Limitations:	none.
+   PR:		none.
+   Originator:	none.  */
+
+/* { dg-do run } */
+#include "ffitest.h"
+
+#define CALLS 3000
+
+typedef struct { long l; double d; } ld_pair;
+
+static long calls;
+
+static int add (int a, int b) { calls++; return a + b; }
+static int sub (int a, int b) { calls++; return a - b; }
+
+static ld_pair
+pair (ld_pair p, signed char c, float f)
+{
+  p.l += c;
+  p.d *= f;
+  return p;
+}
+
+int main (void)
+{
+  ffi_cif cif, cif2;
+  ffi_type *args[MAX_ARGS];
+  void *values[MAX_ARGS];
+  ffi_type pair_type;
+  ffi_type *pair_elements[3];
+  ffi_arg ir;
+  int i, a, b;
+
+  pair_type.size = pair_type.alignment = 0;
+  pair_type.type = FFI_TYPE_STRUCT;
+  pair_type.elements = pair_elements;
+  pair_elements[0] = &ffi_type_slong;
+  pair_elements[1] = &ffi_type_double;
+  pair_elements[2] = NULL;
+
+  /* Two cifs with the same signature, and two targets.  */
+  args[0] = args[1] = &ffi_type_sint;
+  values[0] = &a;
+  values[1] = &b;
+  CHECK(ffi_prep_cif(&cif, FFI_DEFAULT_ABI, 2, &ffi_type_sint, args) == FFI_OK);
+  CHECK(ffi_prep_cif(&cif2, FFI_DEFAULT_ABI, 2, &ffi_type_sint, args) == FFI_OK);
+
+  for (i = 0; i < CALLS; i++)
+    {
+      a = i, b = -7;
+      ffi_call (&cif, FFI_FN((i & 1) ? add : sub), &ir, values);
+      CHECK((int) ir == ((i & 1) ? i - 7 : i + 7));
+      ffi_call (&cif2, FFI_FN(add), &ir, values);
+      CHECK((int) ir == i - 7);
+    }
+  CHECK(calls == 2 * CALLS);
+
+  /* The result may be discarded.  */
+  calls = 0;
+  for (i = 0; i < CALLS; i++)
+    ffi_call (&cif, FFI_FN(add), NULL, values);
+  CHECK(calls == CALLS);
+
+  /* Mixed registers and a structure return.  */
+  {
+    ld_pair p, pr;
+    signed char c;
+    float f = 2.0f;
+
+    args[0] = &pair_type;
+    args[1] = &ffi_type_schar;
+    args[2] = &ffi_type_float;
+    values[0] = &p;
+    values[1] = &c;
+    values[2] = &f;
+    CHECK(ffi_prep_cif(&cif, FFI_DEFAULT_ABI, 3, &pair_type, args) == FFI_OK);
+
+    for (i = 0; i < CALLS; i++)
+      {
+	p.l = i;
+	p.d = i * 0.5;
+	c = (signed char) (i & 0xff);
+	ffi_call (&cif, FFI_FN(pair), &pr, values);
+	CHECK(pr.l == i + (signed char) (i & 0xff) && pr.d == i);
+      }
+  }
+
+  exit(0);
+}
@@ -0,0 +1,141 @@
+/* Area:	ffi_call_on_stack
+   Purpose:	Check calls made on a stack given by the caller.
+   Limitations:	none.
+   PR:		none.
+   Originator:	none.  */
+
+/* { dg-do run } */
+#include "ffitest.h"
+#ifdef __GNUC__
+#include <unwind.h>
+#endif
+
+#define STACK_SIZE (256 * 1024)
+
+typedef struct { long a, b, c, d; } four_longs;
+
+static char *stack_lo, *stack_hi;
+static int on_stack, unwound;
+
+static void
+check_stack (void)
+{
+  char local;
+
+  on_stack = &local > stack_lo && &local < stack_hi;
+}
+
+#ifdef __GNUC__
+/* Note whether the backtrace leads back to main.  */
+static _Unwind_Reason_Code
+trace (struct _Unwind_Context *context, void *arg)
+{
+  void *ip = (void *) _Unwind_GetIP (context);
+
+  if (_Unwind_FindEnclosingFunction (ip) == arg)
+    unwound = 1;
+  return _URC_NO_REASON;
+}
+#endif
+
+int main (void);
+
+static long
+deep (long n)
+{
+  volatile char pad[1024];
+
+  pad[0] = (char) n;
+  if (n == 0)
+    {
+      check_stack ();
+#ifdef __GNUC__
+      _Unwind_Backtrace (trace, (void *) main);
+#endif
+      return pad[0];
+    }
+  return deep (n - 1) + 1 + pad[0];
+}
+
+static four_longs
+spread (long a, long b, long c, long d, long e, long f, four_longs s, int g)
+{
+  four_longs r = { a + b + s.a, c + d + s.b, e + f + s.c, g + s.d };
+
+  check_stack ();
+  return r;
+}
+
+int main (void)
+{
+  ffi_cif cif;
+  ffi_type *args[MAX_ARGS];
+  void *values[MAX_ARGS];
+  ffi_type longs_type;
+  ffi_type *longs_elements[5];
+  ffi_status status;
+  long n = 100, l[6];
+  ffi_arg r;
+  four_longs s = { 1000, 2000, 3000, 4000 }, sr;
+  int g = 7, i;
+
+  stack_lo = malloc (STACK_SIZE);
+  CHECK(stack_lo != NULL);
+  stack_hi = stack_lo + STACK_SIZE;
+
+  args[0] = &ffi_type_slong;
+  values[0] = &n;
+  CHECK(ffi_prep_cif(&cif, FFI_DEFAULT_ABI, 1, &ffi_type_slong, args) == FFI_OK);
+
+  status = ffi_call_on_stack (&cif, FFI_FN(deep), &r, values,
+			      stack_lo, STACK_SIZE);
+  if (status == FFI_BAD_ABI)
+    exit(0);
+  CHECK(status == FFI_OK);
+  CHECK(on_stack);
+#ifdef __GNUC__
+  CHECK(unwound);
+#endif
+  CHECK((long) r == deep (100));
+
+  /* Too small for the argument area, or for the callee.  */
+  CHECK(ffi_call_on_stack (&cif, FFI_FN(deep), &r, values,
+			   stack_lo, 16) == FFI_BAD_STACK);
+  CHECK(ffi_call_on_stack (&cif, FFI_FN(deep), &r, values,
+			   stack_lo, FFI_CALL_ON_STACK_MIN) == FFI_BAD_STACK);
+
+  /* Stack arguments and a structure returned in memory.  */
+  longs_type.size = longs_type.alignment = 0;
+  longs_type.type = FFI_TYPE_STRUCT;
+  longs_type.elements = longs_elements;
+  for (i = 0; i < 4; i++)
+    longs_elements[i] = &ffi_type_slong;
+  longs_elements[4] = NULL;
+
+  for (i = 0; i < 6; i++)
+    {
+      l[i] = i + 1;
+      args[i] = &ffi_type_slong;
+      values[i] = &l[i];
+    }
+  args[6] = &longs_type;
+  values[6] = &s;
+  args[7] = &ffi_type_sint;
+  values[7] = &g;
+  CHECK(ffi_prep_cif(&cif, FFI_DEFAULT_ABI, 8, &longs_type, args) == FFI_OK);
+
+  on_stack = 0;
+  CHECK(ffi_call_on_stack (&cif, FFI_FN(spread), &sr, values,
+			   stack_lo, STACK_SIZE) == FFI_OK);
+  CHECK(on_stack);
+  CHECK(sr.a == 1003 && sr.b == 2007 && sr.c == 3011 && sr.d == 4007);
+
+  /* The result may be discarded.  */
+  on_stack = 0;
+  CHECK(ffi_call_on_stack (&cif, FFI_FN(spread), NULL, values,
+			   stack_lo, STACK_SIZE) == FFI_OK);
+  CHECK(on_stack);
+
+  free (stack_lo);
+  exit(0);
+}
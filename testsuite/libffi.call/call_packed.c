@@ -0,0 +1,89 @@
+/* Area:	ffi_call_packed, ffi_get_packed_layout
+   Purpose:	Check calls from a packed argument buffer.
+   Limitations:	none.
+   PR:		none.
+   Originator:	none.  */
+
+/* { dg-do run } */
+#include "ffitest.h"
+
+typedef struct { char c; double d; } cd_struct;
+
+static double
+mixed (signed char c, double d, short s, cd_struct t, float f, long long l)
+{
+  return c + d + s + t.c + t.d + f + l;
+}
+
+static long
+sum20 (long a0, long a1, long a2, long a3, long a4, long a5, long a6,
+       long a7, long a8, long a9, long a10, long a11, long a12, long a13,
+       long a14, long a15, long a16, long a17, long a18, long a19)
+{
+  return a0 + a1 + a2 + a3 + a4 + a5 + a6 + a7 + a8 + a9 + a10 + a11
+    + a12 + a13 + a14 + a15 + a16 + a17 + a18 + a19;
+}
+
+int main (void)
+{
+  ffi_cif cif;
+  ffi_type *args[MAX_ARGS];
+  ffi_type cd_type;
+  ffi_type *cd_elements[3];
+  size_t offsets[MAX_ARGS], size;
+  double dr;
+  long lr;
+  int i;
+  union { char b[256]; long double align; } buf;
+  cd_struct t = { 3, 0.25 };
+
+  cd_type.size = cd_type.alignment = 0;
+  cd_type.type = FFI_TYPE_STRUCT;
+  cd_type.elements = cd_elements;
+  cd_elements[0] = &ffi_type_schar;
+  cd_elements[1] = &ffi_type_double;
+  cd_elements[2] = NULL;
+
+  args[0] = &ffi_type_schar;
+  args[1] = &ffi_type_double;
+  args[2] = &ffi_type_sshort;
+  args[3] = &cd_type;
+  args[4] = &ffi_type_float;
+  args[5] = &ffi_type_sint64;
+  CHECK(ffi_prep_cif(&cif, FFI_DEFAULT_ABI, 6, &ffi_type_double, args) == FFI_OK);
+
+  size = ffi_get_packed_layout (&cif, offsets);
+  CHECK(offsets[0] == 0);
+  CHECK(offsets[1] == 8);
+  CHECK(offsets[2] == 16);
+  CHECK(offsets[3] == 24);
+  CHECK(offsets[4] == 40);
+  CHECK(offsets[5] == 48);
+  CHECK(size == 56);
+  CHECK(ffi_get_packed_layout (&cif, NULL) == size);
+
+  *(signed char *) (buf.b + offsets[0]) = -7;
+  *(double *) (buf.b + offsets[1]) = 1.5;
+  *(short *) (buf.b + offsets[2]) = -300;
+  memcpy (buf.b + offsets[3], &t, sizeof t);
+  *(float *) (buf.b + offsets[4]) = 2.0f;
+  *(long long *) (buf.b + offsets[5]) = 1000;
+
+  ffi_call_packed (&cif, FFI_FN(mixed), &dr, buf.b);
+  CHECK(dr == mixed (-7, 1.5, -300, t, 2.0f, 1000));
+
+  /* Too many arguments for a precomputed plan on some targets.  */
+  for (i = 0; i < 20; i++)
+    args[i] = &ffi_type_slong;
+  CHECK(ffi_prep_cif(&cif, FFI_DEFAULT_ABI, 20, &ffi_type_slong, args) == FFI_OK);
+
+  size = ffi_get_packed_layout (&cif, offsets);
+  CHECK(size == 20 * sizeof (long));
+  for (i = 0; i < 20; i++)
+    *(long *) (buf.b + offsets[i]) = i + 1;
+
+  ffi_call_packed (&cif, FFI_FN(sum20), &lr, buf.b);
+  CHECK(lr == 210);
+
+  exit(0);
+}
@@ -0,0 +1,82 @@
+/* Area:	ffi_call_strided
+   Purpose:	Check repeated calls with arguments taken from columns.
+   Limitations:	none.
+   PR:		none.
+   Originator:	none.  */
+
+/* { dg-do run } */
+#include "ffitest.h"
+
+#define ROWS 500
+
+typedef struct { float x, y; } point;
+typedef struct { int id; point p; double w; } record;
+
+static long calls;
+
+static double
+weigh (signed char c, point p, double w)
+{
+  calls++;
+  return c * (p.x + p.y) * w;
+}
+
+int main (void)
+{
+  ffi_cif cif;
+  ffi_type *args[MAX_ARGS];
+  ffi_type point_type;
+  ffi_type *point_elements[3];
+  static record records[ROWS];
+  static signed char cs[ROWS];
+  static double out[ROWS][2];
+  void *columns[3];
+  size_t strides[3];
+  int i;
+
+  point_type.size = point_type.alignment = 0;
+  point_type.type = FFI_TYPE_STRUCT;
+  point_type.elements = point_elements;
+  point_elements[0] = point_elements[1] = &ffi_type_float;
+  point_elements[2] = NULL;
+
+  args[0] = &ffi_type_schar;
+  args[1] = &point_type;
+  args[2] = &ffi_type_double;
+  CHECK(ffi_prep_cif(&cif, FFI_DEFAULT_ABI, 3, &ffi_type_double, args) == FFI_OK);
+
+  for (i = 0; i < ROWS; i++)
+    {
+      cs[i] = (signed char) (i % 7 - 3);
+      records[i].id = i;
+      records[i].p.x = (float) i;
+      records[i].p.y = 0.5f;
+      records[i].w = (i & 1) ? 2.0 : 0.25;
+    }
+
+  /* One dense column, and two columns interleaved in an array of
+     records.  Results go to every other double.  */
+  columns[0] = cs;
+  strides[0] = sizeof (cs[0]);
+  columns[1] = &records[0].p;
+  strides[1] = sizeof (record);
+  columns[2] = &records[0].w;
+  strides[2] = sizeof (record);
+
+  ffi_call_strided (&cif, FFI_FN(weigh), ROWS, out, sizeof (out[0]),
+		    columns, strides);
+  CHECK(calls == ROWS);
+  for (i = 0; i < ROWS; i++)
+    {
+      CHECK(out[i][0] == weigh (cs[i], records[i].p, records[i].w));
+      CHECK(out[i][1] == 0);
+    }
+
+  /* A zero stride repeats the same argument.  */
+  calls = 0;
+  strides[0] = 0;
+  ffi_call_strided (&cif, FFI_FN(weigh), ROWS, NULL, 0, columns, strides);
+  CHECK(calls == ROWS);
+
+  exit(0);
+}
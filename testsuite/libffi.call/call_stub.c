@@ -0,0 +1,256 @@
+/* Area:	ffi_prep_call_stub, ffi_call_stub_free
+   Purpose:	Check call stubs generated for a cif.
+   Limitations:	none.
+   PR:		none.
+   Originator:	none.  */
+
+/* { dg-do run } */
+#include "ffitest.h"
+
+#if FFI_CALL_STUBS
+
+typedef struct { long l; double d; } ld_pair;
+typedef struct { char a, b, c; } three_chars;
+typedef struct { float x, y, z; } three_floats;
+typedef struct { long a, b, c, d; } four_longs;
+
+static int add (int a, int b) { return a + b; }
+static int sub (int a, int b) { return a - b; }
+static int widen (signed char c) { return c; }
+static double mix (double d, float f) { return d * f; }
+
+static long
+many (long a, long b, long c, long d, long e, long f, long g, four_longs s)
+{
+  return a + 2*b + 3*c + 4*d + 5*e + 6*f + 7*g + s.a - s.b + s.c - s.d;
+}
+
+static ld_pair
+pair (ld_pair p, int i)
+{
+  p.l += i;
+  p.d *= 2;
+  return p;
+}
+
+static three_chars
+chars (char a)
+{
+  three_chars r = { a, (char) (a + 1), (char) (a + 2) };
+  return r;
+}
+
+static three_floats
+floats (float f)
+{
+  three_floats r = { f, f * 2, f * 3 };
+  return r;
+}
+
+static long double
+ldbl (long double x, int i)
+{
+  return x + i;
+}
+
+static four_longs
+big (long x)
+{
+  four_longs r = { x, x + 1, x + 2, x + 3 };
+  return r;
+}
+
+int main (void)
+{
+  ffi_cif cif;
+  ffi_type *args[MAX_ARGS];
+  void *values[MAX_ARGS];
+  ffi_call_stub stub;
+  ffi_type pair_type, chars_type, floats_type, longs_type;
+  ffi_type *pair_elements[3], *chars_elements[4], *floats_elements[4];
+  ffi_type *longs_elements[5];
+  int i, a, b;
+  ffi_arg ir;
+
+  pair_type.size = pair_type.alignment = 0;
+  pair_type.type = FFI_TYPE_STRUCT;
+  pair_type.elements = pair_elements;
+  pair_elements[0] = &ffi_type_slong;
+  pair_elements[1] = &ffi_type_double;
+  pair_elements[2] = NULL;
+
+  chars_type.size = chars_type.alignment = 0;
+  chars_type.type = FFI_TYPE_STRUCT;
+  chars_type.elements = chars_elements;
+  chars_elements[0] = chars_elements[1] = chars_elements[2] = &ffi_type_schar;
+  chars_elements[3] = NULL;
+
+  floats_type.size = floats_type.alignment = 0;
+  floats_type.type = FFI_TYPE_STRUCT;
+  floats_type.elements = floats_elements;
+  floats_elements[0] = floats_elements[1] = floats_elements[2]
+    = &ffi_type_float;
+  floats_elements[3] = NULL;
+
+  longs_type.size = longs_type.alignment = 0;
+  longs_type.type = FFI_TYPE_STRUCT;
+  longs_type.elements = longs_elements;
+  for (i = 0; i < 4; i++)
+    longs_elements[i] = &ffi_type_slong;
+  longs_elements[4] = NULL;
+
+  /* Bound and unbound targets.  */
+  args[0] = args[1] = &ffi_type_sint;
+  values[0] = &a;
+  values[1] = &b;
+  CHECK(ffi_prep_cif(&cif, FFI_DEFAULT_ABI, 2, &ffi_type_sint, args) == FFI_OK);
+
+  stub = ffi_prep_call_stub (&cif, FFI_FN(add));
+  CHECK(stub != NULL);
+  a = 40, b = 2;
+  stub (NULL, &ir, values);
+  CHECK((int) ir == 42);
+  ffi_call_stub_free (stub);
+
+  stub = ffi_prep_call_stub (&cif, NULL);
+  CHECK(stub != NULL);
+  stub (FFI_FN(add), &ir, values);
+  CHECK((int) ir == 42);
+  stub (FFI_FN(sub), &ir, values);
+  CHECK((int) ir == 38);
+  ffi_call_stub_free (stub);
+
+  /* Sign extension of narrow arguments.  */
+  {
+    signed char c = -5;
+
+    args[0] = &ffi_type_schar;
+    values[0] = &c;
+    CHECK(ffi_prep_cif(&cif, FFI_DEFAULT_ABI, 1, &ffi_type_sint, args) == FFI_OK);
+    stub = ffi_prep_call_stub (&cif, FFI_FN(widen));
+    CHECK(stub != NULL);
+    stub (NULL, &ir, values);
+    CHECK((int) ir == -5);
+    ffi_call_stub_free (stub);
+  }
+
+  /* SSE arguments.  */
+  {
+    double d = 1.5, dr;
+    float f = 4.0f;
+
+    args[0] = &ffi_type_double;
+    args[1] = &ffi_type_float;
+    values[0] = &d;
+    values[1] = &f;
+    CHECK(ffi_prep_cif(&cif, FFI_DEFAULT_ABI, 2, &ffi_type_double, args) == FFI_OK);
+    stub = ffi_prep_call_stub (&cif, FFI_FN(mix));
+    CHECK(stub != NULL);
+    stub (NULL, &dr, values);
+    CHECK(dr == 6.0);
+    ffi_call_stub_free (stub);
+  }
+
+  /* Arguments passed on the stack.  */
+  {
+    long l[7], lr;
+    four_longs s = { 100, 20, 3000, 400 };
+
+    for (i = 0; i < 7; i++)
+      {
+	l[i] = i + 1;
+	args[i] = &ffi_type_slong;
+	values[i] = &l[i];
+      }
+    args[7] = &longs_type;
+    values[7] = &s;
+    CHECK(ffi_prep_cif(&cif, FFI_DEFAULT_ABI, 8, &ffi_type_slong, args) == FFI_OK);
+    stub = ffi_prep_call_stub (&cif, FFI_FN(many));
+    CHECK(stub != NULL);
+    stub (NULL, &lr, values);
+    CHECK(lr == many (1, 2, 3, 4, 5, 6, 7, s));
+    ffi_call_stub_free (stub);
+  }
+
+  /* Mixed INTEGER/SSE struct argument and return.  */
+  {
+    ld_pair p = { 7, 2.25 }, pr;
+    int n = 3;
+
+    args[0] = &pair_type;
+    args[1] = &ffi_type_sint;
+    values[0] = &p;
+    values[1] = &n;
+    CHECK(ffi_prep_cif(&cif, FFI_DEFAULT_ABI, 2, &pair_type, args) == FFI_OK);
+    stub = ffi_prep_call_stub (&cif, FFI_FN(pair));
+    CHECK(stub != NULL);
+    stub (NULL, &pr, values);
+    CHECK(pr.l == 10 && pr.d == 4.5);
+    ffi_call_stub_free (stub);
+  }
+
+  /* Odd-sized struct returns in registers.  */
+  {
+    char c = 'a';
+    three_chars cr;
+    float f = 1.5f;
+    three_floats fr;
+
+    args[0] = &ffi_type_schar;
+    values[0] = &c;
+    CHECK(ffi_prep_cif(&cif, FFI_DEFAULT_ABI, 1, &chars_type, args) == FFI_OK);
+    stub = ffi_prep_call_stub (&cif, FFI_FN(chars));
+    CHECK(stub != NULL);
+    stub (NULL, &cr, values);
+    CHECK(cr.a == 'a' && cr.b == 'b' && cr.c == 'c');
+    ffi_call_stub_free (stub);
+
+    args[0] = &ffi_type_float;
+    values[0] = &f;
+    CHECK(ffi_prep_cif(&cif, FFI_DEFAULT_ABI, 1, &floats_type, args) == FFI_OK);
+    stub = ffi_prep_call_stub (&cif, FFI_FN(floats));
+    CHECK(stub != NULL);
+    stub (NULL, &fr, values);
+    CHECK(fr.x == 1.5f && fr.y == 3.0f && fr.z == 4.5f);
+    ffi_call_stub_free (stub);
+  }
+
+  /* x87 and in-memory returns.  */
+  {
+    long double x = 0.5, xr;
+    int n = 2;
+    long l = 10;
+    four_longs br;
+
+    args[0] = &ffi_type_longdouble;
+    args[1] = &ffi_type_sint;
+    values[0] = &x;
+    values[1] = &n;
+    CHECK(ffi_prep_cif(&cif, FFI_DEFAULT_ABI, 2, &ffi_type_longdouble, args) == FFI_OK);
+    stub = ffi_prep_call_stub (&cif, FFI_FN(ldbl));
+    CHECK(stub != NULL);
+    stub (NULL, &xr, values);
+    CHECK(xr == 2.5);
+    ffi_call_stub_free (stub);
+
+    args[0] = &ffi_type_slong;
+    values[0] = &l;
+    CHECK(ffi_prep_cif(&cif, FFI_DEFAULT_ABI, 1, &longs_type, args) == FFI_OK);
+    stub = ffi_prep_call_stub (&cif, FFI_FN(big));
+    CHECK(stub != NULL);
+    stub (NULL, &br, values);
+    CHECK(br.a == 10 && br.b == 11 && br.c == 12 && br.d == 13);
+    ffi_call_stub_free (stub);
+  }
+
+  exit(0);
+}
+
+#else
+
+int main (void)
+{
+  exit(0);
+}
+
+#endif
@@ -0,0 +1,63 @@
+/* Area:	ffi_prep_call_stub, ffi_call_stub_free
+   Purpose:	Check call stubs allocated past the first 1 MiB step in
+		which a memfd-backed closure heap grows.
+   Limitations:	none.
+   PR:		none.
+   Originator:	none.  */
+
+/* { dg-do run } */
+#include "ffitest.h"
+
+#if FFI_CALL_STUBS
+
+/* Each stub takes at least 64 bytes of code, so these need more than
+   1 MiB.  */
+#define STUBS 20000
+
+static ffi_call_stub stubs[STUBS];
+
+static int add (int a, int b) { return a + b; }
+
+int main (void)
+{
+  ffi_cif cif;
+  ffi_type *args[2];
+  void *values[2];
+  ffi_arg r;
+  int a, b, i;
+
+  args[0] = &ffi_type_sint;
+  args[1] = &ffi_type_sint;
+  CHECK(ffi_prep_cif(&cif, FFI_DEFAULT_ABI, 2, &ffi_type_sint, args) == FFI_OK);
+
+  for (i = 0; i < STUBS; i++)
+    {
+      stubs[i] = ffi_prep_call_stub (&cif, FFI_FN(add));
+      CHECK(stubs[i] != NULL);
+    }
+
+  /* Every stub is still usable once the heap has grown.  */
+  values[0] = &a;
+  values[1] = &b;
+  b = 7;
+  for (i = 0; i < STUBS; i++)
+    {
+      a = i;
+      r = 0;
+      stubs[i] (NULL, &r, values);
+      CHECK((int) r == i + 7);
+    }
+
+  for (i = STUBS; i--; )
+    ffi_call_stub_free (stubs[i]);
+  exit(0);
+}
+
+#else
+
+int main (void)
+{
+  exit(0);
+}
+
+#endif
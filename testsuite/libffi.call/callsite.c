@@ -0,0 +1,105 @@
+/* Area:	ffi_callsite_alloc, ffi_callsite_arg, ffi_callsite_call
+   Purpose:	Check call sites that keep their arguments between calls.
+   Limitations:	none.
+   PR:		none.
+   Originator:	none.  */
+
+/* { dg-do run } */
+#include "ffitest.h"
+
+typedef struct { long l; double d; } ld_pair;
+typedef struct { double x, y; } dd_pair;
+typedef struct { long a, b, c, d; } big_struct;
+
+static big_struct
+combine (signed char c, ld_pair p, dd_pair q, double d, long a, long b,
+	 long e, long f, long g, long h, short s)
+{
+  big_struct r;
+
+  r.a = c + p.l + a + b;
+  r.b = (long) (p.d + q.x + q.y + d);
+  r.c = e + f + g + h;
+  r.d = s;
+  return r;
+}
+
+int main (void)
+{
+  ffi_cif cif;
+  ffi_type *args[MAX_ARGS];
+  ffi_type ld_type, dd_type, big_type;
+  ffi_type *ld_elements[3], *dd_elements[3], *big_elements[5];
+  ffi_callsite *site;
+  big_struct r;
+  ld_pair p = { 100, 0.5 };
+  dd_pair q = { 1.25, 2.25 };
+  int i;
+
+  ld_type.size = ld_type.alignment = 0;
+  ld_type.type = FFI_TYPE_STRUCT;
+  ld_type.elements = ld_elements;
+  ld_elements[0] = &ffi_type_slong;
+  ld_elements[1] = &ffi_type_double;
+  ld_elements[2] = NULL;
+
+  dd_type.size = dd_type.alignment = 0;
+  dd_type.type = FFI_TYPE_STRUCT;
+  dd_type.elements = dd_elements;
+  dd_elements[0] = dd_elements[1] = &ffi_type_double;
+  dd_elements[2] = NULL;
+
+  big_type.size = big_type.alignment = 0;
+  big_type.type = FFI_TYPE_STRUCT;
+  big_type.elements = big_elements;
+  for (i = 0; i < 4; i++)
+    big_elements[i] = &ffi_type_slong;
+  big_elements[4] = NULL;
+
+  args[0] = &ffi_type_schar;
+  args[1] = &ld_type;
+  args[2] = &dd_type;
+  args[3] = &ffi_type_double;
+  for (i = 4; i < 10; i++)
+    args[i] = &ffi_type_slong;
+  args[10] = &ffi_type_sshort;
+  CHECK(ffi_prep_cif(&cif, FFI_DEFAULT_ABI, 11, &big_type, args) == FFI_OK);
+
+  site = ffi_callsite_alloc (&cif, FFI_FN(combine));
+  CHECK(site != NULL);
+
+  *(signed char *) ffi_callsite_arg (site, 0) = -3;
+  memcpy (ffi_callsite_arg (site, 1), &p, sizeof p);
+  memcpy (ffi_callsite_arg (site, 2), &q, sizeof q);
+  *(double *) ffi_callsite_arg (site, 3) = 4.0;
+  for (i = 4; i < 10; i++)
+    *(long *) ffi_callsite_arg (site, i) = i;
+  *(short *) ffi_callsite_arg (site, 10) = -9;
+
+  ffi_callsite_call (site, &r);
+  CHECK(r.a == -3 + 100 + 4 + 5);
+  CHECK(r.b == 8);
+  CHECK(r.c == 6 + 7 + 8 + 9);
+  CHECK(r.d == -9);
+
+  /* Change one argument at a time; the others are kept.  */
+  for (i = 0; i < 100; i++)
+    {
+      *(long *) ffi_callsite_arg (site, 9) = i;
+      ffi_callsite_call (site, &r);
+      CHECK(r.a == 106);
+      CHECK(r.c == 6 + 7 + 8 + i);
+    }
+
+  *(signed char *) ffi_callsite_arg (site, 0) = 5;
+  ((ld_pair *) ffi_callsite_arg (site, 1))->d = 10.5;
+  ffi_callsite_call (site, &r);
+  CHECK(r.a == 5 + 100 + 4 + 5);
+  CHECK(r.b == 18);
+
+  /* The result may be discarded.  */
+  ffi_callsite_call (site, NULL);
+
+  ffi_callsite_free (site);
+  exit(0);
+}
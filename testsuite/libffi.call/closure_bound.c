@@ -0,0 +1,146 @@
+/* Area:	ffi_prep_bound_closure, ffi_bound_closure_free
+   Purpose:	Check closures that bind leading arguments.
+   Limitations:	none.
+   PR:		none.
+   Originator:	none.  */
+
+/* { dg-do run } */
+#include "ffitest.h"
+
+#if FFI_CALL_STUBS
+
+typedef struct { long a, b, c, d; } four_longs;
+
+struct counter { int calls; };
+
+static int
+impl (struct counter *ctx, int a, int b)
+{
+  ctx->calls++;
+  return a * 10 + b;
+}
+
+static double
+spread (long k, double d, float f, signed char c, long a0, double d0,
+	long a1, double d1, long a2, double d2, long a3, double d3,
+	long a4, double d4, long a5, double d5, long a6, double d6,
+	double d7)
+{
+  return k + d * 2 + f * 3 + c * 4 + a0 * 5 + d0 * 6 + a1 * 7 + d1 * 8
+    + a2 * 9 + d2 * 10 + a3 * 11 + d3 * 12 + a4 * 13 + d4 * 14
+    + a5 * 15 + d5 * 16 + a6 * 17 + d6 * 18 + d7 * 19;
+}
+
+static four_longs
+fill (long base, int step)
+{
+  four_longs r = { base, base + step, base + 2 * step, base + 3 * step };
+  return r;
+}
+
+static long seen;
+static void note (long x) { seen = x; }
+
+typedef int (*cb_fn) (int, int);
+typedef double (*spread_fn) (long, double, long, double, long, double,
+			     long, double, long, double, long, double,
+			     long, double, double);
+typedef four_longs (*fill_fn) (int);
+typedef void (*note_fn) (void);
+
+int main (void)
+{
+  ffi_cif cif;
+  ffi_type *args[MAX_ARGS];
+  ffi_type big_type;
+  ffi_type *big_elements[5];
+  void *values[4];
+  struct counter ctx = { 0 };
+  struct counter *ctxp = &ctx;
+  long k = 1000, base = 5;
+  double d = 0.5;
+  float f = 0.25f;
+  signed char c = -3;
+  four_longs r;
+  void *bound;
+  int i;
+
+  /* The common case: a context pointer in front.  */
+  args[0] = &ffi_type_pointer;
+  args[1] = &ffi_type_sint;
+  args[2] = &ffi_type_sint;
+  CHECK(ffi_prep_cif(&cif, FFI_DEFAULT_ABI, 3, &ffi_type_sint, args) == FFI_OK);
+  values[0] = &ctxp;
+  bound = ffi_prep_bound_closure (&cif, FFI_FN(impl), 1, values);
+  CHECK(bound != NULL);
+  CHECK(((cb_fn) bound) (4, 2) == 42);
+  CHECK(((cb_fn) bound) (-1, 7) == -3);
+  CHECK(ctx.calls == 2);
+  ffi_bound_closure_free (bound);
+
+  /* Enough arguments that some move from registers to the stack.  */
+  args[0] = &ffi_type_slong;
+  args[1] = &ffi_type_double;
+  args[2] = &ffi_type_float;
+  args[3] = &ffi_type_schar;
+  for (i = 0; i < 7; i++)
+    {
+      args[4 + 2 * i] = &ffi_type_slong;
+      args[5 + 2 * i] = &ffi_type_double;
+    }
+  args[18] = &ffi_type_double;
+  CHECK(ffi_prep_cif(&cif, FFI_DEFAULT_ABI, 19, &ffi_type_double, args) == FFI_OK);
+  values[0] = &k;
+  values[1] = &d;
+  values[2] = &f;
+  values[3] = &c;
+  bound = ffi_prep_bound_closure (&cif, FFI_FN(spread), 4, values);
+  CHECK(bound != NULL);
+  CHECK(((spread_fn) bound) (1, 1.5, 2, 2.5, 3, 3.5, 4, 4.5, 5, 5.5,
+			     6, 6.5, 7, 7.5, 8.5)
+	== spread (1000, 0.5, 0.25f, -3, 1, 1.5, 2, 2.5, 3, 3.5, 4, 4.5,
+		   5, 5.5, 6, 6.5, 7, 7.5, 8.5));
+  ffi_bound_closure_free (bound);
+
+  /* Structures returned in memory.  */
+  big_type.size = big_type.alignment = 0;
+  big_type.type = FFI_TYPE_STRUCT;
+  big_type.elements = big_elements;
+  for (i = 0; i < 4; i++)
+    big_elements[i] = &ffi_type_slong;
+  big_elements[4] = NULL;
+
+  args[0] = &ffi_type_slong;
+  args[1] = &ffi_type_sint;
+  CHECK(ffi_prep_cif(&cif, FFI_DEFAULT_ABI, 2, &big_type, args) == FFI_OK);
+  values[0] = &base;
+  bound = ffi_prep_bound_closure (&cif, FFI_FN(fill), 1, values);
+  CHECK(bound != NULL);
+  r = ((fill_fn) bound) (3);
+  CHECK(r.a == 5 && r.b == 8 && r.c == 11 && r.d == 14);
+  ffi_bound_closure_free (bound);
+
+  /* Every argument bound.  */
+  CHECK(ffi_prep_cif(&cif, FFI_DEFAULT_ABI, 1, &ffi_type_void, args) == FFI_OK);
+  bound = ffi_prep_bound_closure (&cif, FFI_FN(note), 1, values);
+  CHECK(bound != NULL);
+  ((note_fn) bound) ();
+  CHECK(seen == 5);
+  ffi_bound_closure_free (bound);
+
+  /* Structure arguments are not supported.  */
+  args[0] = &big_type;
+  CHECK(ffi_prep_cif(&cif, FFI_DEFAULT_ABI, 1, &ffi_type_void, args) == FFI_OK);
+  CHECK(ffi_prep_bound_closure (&cif, FFI_FN(note), 0, values) == NULL);
+
+  exit(0);
+}
+
+#else
+
+int main (void)
+{
+  exit(0);
+}
+
+#endif
@@ -0,0 +1,156 @@
+/* Area:	ffi_prep_deferred_closure, ffi_deferred_drain
+   Purpose:	Check closures that queue their calls for another thread.
+   Limitations:	none.
+   PR:		none.
+   Originator:	none.  */
+
+/* { dg-do run } */
+#include "ffitest.h"
+
+#if FFI_DEFERRED_CLOSURES && !defined (_WIN32)
+
+#include <pthread.h>
+
+#define THREADS 4
+#define CALLS 1000
+
+typedef struct { char c; short s; } cs_struct;
+typedef void (*record_fn) (int, double, cs_struct);
+
+static record_fn record;
+static long last[THREADS];
+static long drained;
+static double total;
+
+static void
+run (ffi_cif *cif __UNUSED__, void **args, void *user_data)
+{
+  int id = *(int *) args[0];
+  double d = *(double *) args[1];
+  cs_struct t = *(cs_struct *) args[2];
+  long n = (long) d;
+
+  /* Calls from one thread are run in the order they were made.  */
+  CHECK(user_data == &drained);
+  CHECK(n == last[id] + 1);
+  CHECK(t.c == id && t.s == -n);
+  last[id] = n;
+  total += d;
+  drained++;
+}
+
+static void *
+producer (void *arg)
+{
+  int id = (int) (long) arg;
+  long i;
+
+  for (i = 1; i <= CALLS; i++)
+    {
+      cs_struct t = { (char) id, (short) -i };
+      record (id, (double) i, t);
+    }
+  return NULL;
+}
+
+int main (void)
+{
+  ffi_deferred_closure *closure;
+  ffi_deferred_queue *q, *small;
+  ffi_cif cif, bad_cif;
+  ffi_type *args[MAX_ARGS];
+  ffi_type *many[FFI_DEFERRED_MAX_ARGS + 1];
+  ffi_type cs_type;
+  ffi_type *cs_elements[3];
+  pthread_t threads[THREADS];
+  void *code;
+  cs_struct t = { 0, 0 };
+  long i;
+
+  cs_type.size = cs_type.alignment = 0;
+  cs_type.type = FFI_TYPE_STRUCT;
+  cs_type.elements = cs_elements;
+  cs_elements[0] = &ffi_type_schar;
+  cs_elements[1] = &ffi_type_sshort;
+  cs_elements[2] = NULL;
+
+  args[0] = &ffi_type_sint;
+  args[1] = &ffi_type_double;
+  args[2] = &cs_type;
+  CHECK(ffi_prep_cif(&cif, FFI_DEFAULT_ABI, 3, &ffi_type_void, args) == FFI_OK);
+  CHECK(ffi_get_packed_layout (&cif, NULL) == 20);
+
+  CHECK(ffi_deferred_queue_alloc (0, 32) == NULL);
+  q = ffi_deferred_queue_alloc (THREADS * CALLS, 20);
+  CHECK(q != NULL);
+
+  closure = ffi_closure_alloc (sizeof (ffi_deferred_closure), &code);
+  CHECK(closure != NULL);
+
+  /* Only void closures with room for their arguments.  */
+  CHECK(ffi_prep_cif(&bad_cif, FFI_DEFAULT_ABI, 3, &ffi_type_sint, args) == FFI_OK);
+  CHECK(ffi_prep_deferred_closure (closure, &bad_cif, q, run, &drained, code)
+	== FFI_BAD_TYPEDEF);
+  small = ffi_deferred_queue_alloc (4, 16);
+  CHECK(small != NULL);
+  CHECK(ffi_prep_deferred_closure (closure, &cif, small, run, &drained, code)
+	== FFI_BAD_TYPEDEF);
+  ffi_deferred_queue_free (small);
+  for (i = 0; i <= FFI_DEFERRED_MAX_ARGS; i++)
+    many[i] = &ffi_type_schar;
+  CHECK(ffi_prep_cif(&bad_cif, FFI_DEFAULT_ABI, FFI_DEFERRED_MAX_ARGS + 1,
+		     &ffi_type_void, many) == FFI_OK);
+  CHECK(ffi_prep_deferred_closure (closure, &bad_cif, q, run, &drained, code)
+	== FFI_BAD_TYPEDEF);
+
+  /* Calls made while the queue is full are dropped.  */
+  small = ffi_deferred_queue_alloc (3, 20);
+  CHECK(ffi_prep_deferred_closure (closure, &cif, small, run, &drained, code)
+	== FFI_OK);
+  record = (record_fn) code;
+  for (i = 1; i <= 6; i++)
+    {
+      t.s = (short) -i;
+      record (0, (double) i, t);
+    }
+  CHECK(ffi_deferred_dropped (small) == 2);
+  CHECK(ffi_deferred_drain (small, 1) == 1);
+  CHECK(ffi_deferred_drain (small, 100) == 3);
+  CHECK(ffi_deferred_drain (small, 100) == 0);
+  CHECK(drained == 4 && total == 10);
+  ffi_deferred_queue_free (small);
+
+  /* Calls from several threads at once.  */
+  last[0] = 0;
+  drained = 0;
+  total = 0;
+  CHECK(ffi_prep_deferred_closure (closure, &cif, q, run, &drained, code)
+	== FFI_OK);
+  for (i = 0; i < THREADS; i++)
+    CHECK(pthread_create (&threads[i], NULL, producer, (void *) i) == 0);
+
+  /* Drain while the threads are still calling.  */
+  while (drained < THREADS * CALLS)
+    ffi_deferred_drain (q, 64);
+  for (i = 0; i < THREADS; i++)
+    pthread_join (threads[i], NULL);
+
+  CHECK(ffi_deferred_dropped (q) == 0);
+  CHECK(ffi_deferred_drain (q, 100) == 0);
+  CHECK(total == THREADS * (CALLS * (CALLS + 1) / 2.0));
+  for (i = 0; i < THREADS; i++)
+    CHECK(last[i] == CALLS);
+
+  ffi_closure_free (closure);
+  ffi_deferred_queue_free (q);
+  exit(0);
+}
+
+#else
+
+int main (void)
+{
+  exit(0);
+}
+
+#endif
@@ -0,0 +1,127 @@
+/* Area:	ffi_closure_family_alloc, ffi_prep_closure_family
+   Purpose:	Check closures allocated together with one handler.
+   Limitations:	none.
+   PR:		none.
+   Originator:	none.  */
+
+/* { dg-do run } */
+#include "ffitest.h"
+
+#define FAMILIES 100
+/* More closures than one table of static trampolines holds.  */
+#define BIG 300
+
+/* A small interface, in the style of COM.  */
+typedef struct object object;
+typedef struct
+{
+  int (*add_ref) (object *);
+  double (*scale) (object *, double);
+  void (*set) (object *, int, long);
+} object_vtbl;
+
+struct object
+{
+  object_vtbl *vtbl;
+  int refs;
+  long value;
+};
+
+static void
+dispatch (ffi_cif *cif __UNUSED__, void *ret, void **args,
+	  unsigned int index, void *user_data)
+{
+  object *obj = *(object **) args[0];
+
+  CHECK(user_data == obj);
+  switch (index)
+    {
+    case 0:
+      *(ffi_arg *) ret = ++obj->refs;
+      break;
+    case 1:
+      *(double *) ret = obj->value * *(double *) args[1];
+      break;
+    case 2:
+      obj->value = *(int *) args[1] * *(long *) args[2];
+      break;
+    default:
+      abort ();
+    }
+}
+
+static void
+add_index (ffi_cif *cif __UNUSED__, void *ret, void **args,
+	   unsigned int index, void *user_data)
+{
+  CHECK(user_data == NULL);
+  *(ffi_arg *) ret = *(int *) args[0] + index;
+}
+
+int main (void)
+{
+  static void *code[BIG];
+  static ffi_cif *big_cifs[BIG];
+  ffi_closure_family *big;
+  static ffi_closure_family *families[FAMILIES];
+  static object_vtbl vtbls[FAMILIES];
+  static object objects[FAMILIES];
+  ffi_cif add_ref_cif, scale_cif, set_cif;
+  ffi_cif *cifs[3];
+  ffi_type *args[2], *set_args[3], *big_args[1];
+  int i;
+
+  args[0] = &ffi_type_pointer;
+  args[1] = &ffi_type_double;
+  CHECK(ffi_prep_cif(&add_ref_cif, FFI_DEFAULT_ABI, 1, &ffi_type_sint, args) == FFI_OK);
+  CHECK(ffi_prep_cif(&scale_cif, FFI_DEFAULT_ABI, 2, &ffi_type_double, args) == FFI_OK);
+  set_args[0] = &ffi_type_pointer;
+  set_args[1] = &ffi_type_sint;
+  set_args[2] = &ffi_type_slong;
+  CHECK(ffi_prep_cif(&set_cif, FFI_DEFAULT_ABI, 3, &ffi_type_void, set_args) == FFI_OK);
+  cifs[0] = &add_ref_cif;
+  cifs[1] = &scale_cif;
+  cifs[2] = &set_cif;
+
+  CHECK(ffi_closure_family_alloc (0, (void **) &vtbls[0]) == NULL);
+
+  for (i = 0; i < FAMILIES; i++)
+    {
+      families[i] = ffi_closure_family_alloc (3, (void **) &vtbls[i]);
+      CHECK(families[i] != NULL);
+      CHECK(ffi_prep_closure_family (families[i], cifs, dispatch,
+				     &objects[i]) == FFI_OK);
+      objects[i].vtbl = &vtbls[i];
+#if FFI_EXEC_STATIC_TRAMP
+      /* The trampolines of a family are consecutive.  */
+      CHECK((char *) vtbls[i].scale - (char *) vtbls[i].add_ref
+	    == (char *) vtbls[i].set - (char *) vtbls[i].scale);
+#endif
+    }
+
+  for (i = 0; i < FAMILIES; i++)
+    {
+      object *obj = &objects[i];
+
+      CHECK(obj->vtbl->add_ref (obj) == 1);
+      CHECK(obj->vtbl->add_ref (obj) == 2);
+      obj->vtbl->set (obj, i, -3);
+      CHECK(obj->value == -3L * i);
+      CHECK(obj->vtbl->scale (obj, 0.5) == -1.5 * i);
+    }
+
+  for (i = 0; i < FAMILIES; i++)
+    ffi_closure_family_free (families[i]);
+
+  big_args[0] = &ffi_type_sint;
+  CHECK(ffi_prep_cif(&add_ref_cif, FFI_DEFAULT_ABI, 1, &ffi_type_sint, big_args) == FFI_OK);
+  for (i = 0; i < BIG; i++)
+    big_cifs[i] = &add_ref_cif;
+  big = ffi_closure_family_alloc (BIG, code);
+  CHECK(big != NULL);
+  CHECK(ffi_prep_closure_family (big, big_cifs, add_index, NULL) == FFI_OK);
+  for (i = 0; i < BIG; i++)
+    CHECK(((int (*)(int)) code[i]) (-7) == i - 7);
+  ffi_closure_family_free (big);
+  exit(0);
+}
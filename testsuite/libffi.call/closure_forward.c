@@ -0,0 +1,220 @@
+/* Area:	ffi_prep_forwarding_closure
+   Purpose:	Check that forwarding closures pass arguments and
+		results through, and show them to the hooks.
+   Limitations:	none.
+   PR:		none.
+   Originator:	none.  */
+
+/* { dg-do run } */
+#include "ffitest.h"
+
+#if FFI_FORWARDING_CLOSURES
+
+typedef struct { long a, b, c, d; } four_longs;
+typedef struct { double x; long n; } double_long;
+
+static int pre_calls, post_calls;
+static void *seen_data;
+
+static double
+many (int a, double b, long c, long d, long e, long f, long g, long h,
+      float i, four_longs s, signed char j)
+{
+  return a + b + c + 2 * d + 3 * e + 4 * f + 5 * g + 6 * h + i
+    + s.a - s.b + s.c - s.d + j;
+}
+
+static four_longs
+spread (long x, double y)
+{
+  four_longs r = { x, x + 1, (long) y, (long) y + 1 };
+  return r;
+}
+
+static long double
+ldbl (long double x, int n)
+{
+  return x * n;
+}
+
+static signed char
+neg (signed char c)
+{
+  return -c;
+}
+
+static double_long
+pair (double x, long n)
+{
+  double_long r = { x, n };
+  return r;
+}
+
+/* The hooks disturb the argument and return registers.  */
+
+static double
+noise (double a, double b, double c, double d, double e, double f,
+       double g, double h, long double x)
+{
+  return a * b + c * d + e * f + g * h + (double) (x * x);
+}
+
+static void
+pre (ffi_cif *cif, void **avalue, void *data)
+{
+  seen_data = data;
+  pre_calls++;
+  if (cif->nargs == 11)
+    {
+      CHECK(*(int *) avalue[0] == 1);
+      CHECK(*(double *) avalue[1] == 0.5);
+      CHECK(*(long *) avalue[7] == 7);
+      CHECK(*(float *) avalue[8] == 0.25f);
+      CHECK(((four_longs *) avalue[9])->d == 4);
+      CHECK(*(signed char *) avalue[10] == -9);
+    }
+  else if (cif->rtype == &ffi_type_longdouble)
+    {
+      CHECK(*(long double *) avalue[0] == 1.5L);
+      CHECK(*(int *) avalue[1] == 3);
+    }
+  noise (1, 2, 3, 4, 5, 6, 7, 8, 9);
+}
+
+/* The post hook checks the return value and changes it.  */
+
+static void
+post (ffi_cif *cif, void *rvalue, void *data)
+{
+  (void) data;
+  post_calls++;
+  if (cif->rtype == &ffi_type_double)
+    *(double *) rvalue += 1;
+  else if (cif->rtype == &ffi_type_longdouble)
+    {
+      CHECK(*(long double *) rvalue == 4.5L);
+      *(long double *) rvalue = 9.5L;
+    }
+  else if (cif->rtype == &ffi_type_schar)
+    {
+      CHECK(*(ffi_sarg *) rvalue == -5);
+      *(ffi_sarg *) rvalue = -6;
+    }
+  else if (cif->rtype->size == sizeof (four_longs))
+    {
+      CHECK(((four_longs *) rvalue)->a == 40);
+      ((four_longs *) rvalue)->d = 99;
+    }
+  else
+    {
+      CHECK(((double_long *) rvalue)->x == 2.5);
+      CHECK(((double_long *) rvalue)->n == 7);
+      ((double_long *) rvalue)->n = 8;
+    }
+  noise (8, 7, 6, 5, 4, 3, 2, 1, 0);
+}
+
+int main (void)
+{
+  ffi_cif cif;
+  ffi_type *args[MAX_ARGS];
+  ffi_type longs_type, pair_type;
+  ffi_type *longs_elements[5], *pair_elements[3];
+  ffi_forwarding_closure *fc;
+  void *code;
+  int i;
+  four_longs s = { 1000, 200, 30, 4 }, r;
+
+  longs_type.size = longs_type.alignment = 0;
+  longs_type.type = FFI_TYPE_STRUCT;
+  longs_type.elements = longs_elements;
+  for (i = 0; i < 4; i++)
+    longs_elements[i] = &ffi_type_slong;
+  longs_elements[4] = NULL;
+
+  pair_type.size = pair_type.alignment = 0;
+  pair_type.type = FFI_TYPE_STRUCT;
+  pair_type.elements = pair_elements;
+  pair_elements[0] = &ffi_type_double;
+  pair_elements[1] = &ffi_type_slong;
+  pair_elements[2] = NULL;
+
+  fc = ffi_closure_alloc (sizeof (ffi_forwarding_closure), &code);
+  CHECK(fc != NULL);
+
+  /* Register and stack arguments, with and without a post hook.  */
+  args[0] = &ffi_type_sint;
+  args[1] = &ffi_type_double;
+  for (i = 2; i < 8; i++)
+    args[i] = &ffi_type_slong;
+  args[8] = &ffi_type_float;
+  args[9] = &longs_type;
+  args[10] = &ffi_type_schar;
+  CHECK(ffi_prep_cif(&cif, FFI_DEFAULT_ABI, 11, &ffi_type_double, args) == FFI_OK);
+
+  CHECK(ffi_prep_forwarding_closure (fc, &cif, FFI_FN(many), pre, NULL,
+				     (void *) &cif) == FFI_OK);
+  CHECK(((double (*)(int, double, long, long, long, long, long, long, float,
+		     four_longs, signed char)) code)
+	(1, 0.5, 2, 3, 4, 5, 6, 7, 0.25f, s, -9)
+	== many (1, 0.5, 2, 3, 4, 5, 6, 7, 0.25f, s, -9));
+  CHECK(pre_calls == 1 && post_calls == 0 && seen_data == &cif);
+
+  CHECK(ffi_prep_forwarding_closure (fc, &cif, FFI_FN(many), pre, post,
+				     NULL) == FFI_OK);
+  CHECK(((double (*)(int, double, long, long, long, long, long, long, float,
+		     four_longs, signed char)) code)
+	(1, 0.5, 2, 3, 4, 5, 6, 7, 0.25f, s, -9)
+	== many (1, 0.5, 2, 3, 4, 5, 6, 7, 0.25f, s, -9) + 1);
+  CHECK(pre_calls == 2 && post_calls == 1 && seen_data == NULL);
+
+  /* A structure returned in memory.  */
+  args[0] = &ffi_type_slong;
+  args[1] = &ffi_type_double;
+  CHECK(ffi_prep_cif(&cif, FFI_DEFAULT_ABI, 2, &longs_type, args) == FFI_OK);
+  CHECK(ffi_prep_forwarding_closure (fc, &cif, FFI_FN(spread), NULL, post,
+				     NULL) == FFI_OK);
+  r = ((four_longs (*)(long, double)) code) (40, 50.0);
+  CHECK(r.a == 40 && r.b == 41 && r.c == 50 && r.d == 99);
+  CHECK(pre_calls == 2 && post_calls == 2);
+
+  /* An x87 return value.  */
+  args[0] = &ffi_type_longdouble;
+  args[1] = &ffi_type_sint;
+  CHECK(ffi_prep_cif(&cif, FFI_DEFAULT_ABI, 2, &ffi_type_longdouble, args) == FFI_OK);
+  CHECK(ffi_prep_forwarding_closure (fc, &cif, FFI_FN(ldbl), pre, post,
+				     NULL) == FFI_OK);
+  CHECK(((long double (*)(long double, int)) code) (1.5L, 3) == 9.5L);
+  CHECK(pre_calls == 3 && post_calls == 3);
+
+  /* A small integer, and a structure split between %xmm0 and %rax.  */
+  args[0] = &ffi_type_schar;
+  CHECK(ffi_prep_cif(&cif, FFI_DEFAULT_ABI, 1, &ffi_type_schar, args) == FFI_OK);
+  CHECK(ffi_prep_forwarding_closure (fc, &cif, FFI_FN(neg), NULL, post,
+				     NULL) == FFI_OK);
+  CHECK(((signed char (*)(signed char)) code) (5) == -6);
+
+  args[0] = &ffi_type_double;
+  args[1] = &ffi_type_slong;
+  CHECK(ffi_prep_cif(&cif, FFI_DEFAULT_ABI, 2, &pair_type, args) == FFI_OK);
+  CHECK(ffi_prep_forwarding_closure (fc, &cif, FFI_FN(pair), NULL, post,
+				     NULL) == FFI_OK);
+  {
+    double_long p = ((double_long (*)(double, long)) code) (2.5, 7);
+
+    CHECK(p.x == 2.5 && p.n == 8);
+  }
+  CHECK(post_calls == 5);
+
+  ffi_closure_free (fc);
+  exit(0);
+}
+
+#else
+
+int main (void)
+{
+  exit(0);
+}
+
+#endif
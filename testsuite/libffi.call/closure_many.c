@@ -0,0 +1,54 @@
+/* Area:	ffi_closure_alloc, ffi_closure_free
+   Purpose:	Check many live closures, freed and allocated again.
+   Limitations:	none.
+   PR:		none.
+   Originator:	none.  */
+
+/* { dg-do run } */
+#include "ffitest.h"
+
+#define CLOSURES 1000
+
+static void
+add_index (ffi_cif *cif __UNUSED__, void *ret, void **args, void *user_data)
+{
+  *(ffi_arg *) ret = *(int *) args[0] + (int) (intptr_t) user_data;
+}
+
+static void
+make (ffi_cif *cif, ffi_closure **cl, void **code, int i)
+{
+  cl[i] = ffi_closure_alloc (sizeof (ffi_closure), &code[i]);
+  CHECK(cl[i] != NULL);
+  CHECK(ffi_prep_closure_loc (cl[i], cif, add_index, (void *) (intptr_t) i,
+			      code[i]) == FFI_OK);
+}
+
+int main (void)
+{
+  ffi_cif cif;
+  ffi_type *args[1];
+  static ffi_closure *cl[CLOSURES];
+  static void *code[CLOSURES];
+  int i;
+
+  args[0] = &ffi_type_sint;
+  CHECK(ffi_prep_cif(&cif, FFI_DEFAULT_ABI, 1, &ffi_type_sint, args) == FFI_OK);
+
+  for (i = 0; i < CLOSURES; i++)
+    make (&cif, cl, code, i);
+  for (i = 0; i < CLOSURES; i++)
+    CHECK(((int (*)(int)) code[i]) (5) == 5 + i);
+
+  /* Free every other closure, and reuse the slots.  */
+  for (i = 0; i < CLOSURES; i += 2)
+    ffi_closure_free (cl[i]);
+  for (i = 0; i < CLOSURES; i += 2)
+    make (&cif, cl, code, i);
+  for (i = 0; i < CLOSURES; i++)
+    CHECK(((int (*)(int)) code[i]) (-5) == i - 5);
+
+  for (i = 0; i < CLOSURES; i++)
+    ffi_closure_free (cl[i]);
+  exit(0);
+}
@@ -0,0 +1,105 @@
+/* Area:	ffi_closure_alloc, ffi_closure_free
+   Purpose:	Check closures allocated on one thread and freed on
+		another.
+   Limitations:	none.
+   PR:		none.
+   Originator:	none.  */
+
+/* { dg-do run } */
+#include "ffitest.h"
+
+#ifndef _WIN32
+
+#include <pthread.h>
+
+#define THREADS 4
+#define CLOSURES 300
+#define ROUNDS 6
+
+static ffi_cif cif;
+static ffi_closure *cl[THREADS][CLOSURES];
+static void *code[THREADS][CLOSURES];
+static int round_no;
+
+static void
+add_tag (ffi_cif *cif __UNUSED__, void *ret, void **args, void *user_data)
+{
+  *(ffi_arg *) ret = *(int *) args[0] + (int) (intptr_t) user_data;
+}
+
+static int
+tag (int r, int set, int i)
+{
+  return r * 100000 + set * 1000 + i;
+}
+
+/* Sizes up to and beyond the largest one that is cached.  */
+static size_t
+size_of (int i)
+{
+  return sizeof (ffi_closure) + (i % 3) * 150;
+}
+
+/* Each thread frees the closures that another thread made in the
+   previous round, and makes new ones in their place.  */
+static void *
+work (void *arg)
+{
+  int id = (int) (intptr_t) arg;
+  int set = (id + round_no) % THREADS;
+  int i;
+
+  for (i = 0; i < CLOSURES; i++)
+    {
+      if (cl[set][i] != NULL)
+	{
+	  CHECK(((int (*)(int)) code[set][i]) (1)
+		== tag (round_no - 1, set, i) + 1);
+	  ffi_closure_free (cl[set][i]);
+	}
+      cl[set][i] = ffi_closure_alloc (size_of (i), &code[set][i]);
+      CHECK(cl[set][i] != NULL);
+      memset (cl[set][i], 0xcc, size_of (i));
+      CHECK(ffi_prep_closure_loc (cl[set][i], &cif, add_tag,
+				  (void *) (intptr_t) tag (round_no, set, i),
+				  code[set][i]) == FFI_OK);
+    }
+  return NULL;
+}
+
+int main (void)
+{
+  pthread_t th[THREADS];
+  ffi_type *args[1];
+  int r, t, i;
+
+  args[0] = &ffi_type_sint;
+  CHECK(ffi_prep_cif(&cif, FFI_DEFAULT_ABI, 1, &ffi_type_sint, args) == FFI_OK);
+
+  for (r = 1; r <= ROUNDS; r++)
+    {
+      round_no = r;
+      for (t = 0; t < THREADS; t++)
+	CHECK(pthread_create (&th[t], NULL, work, (void *) (intptr_t) t) == 0);
+      for (t = 0; t < THREADS; t++)
+	CHECK(pthread_join (th[t], NULL) == 0);
+
+      /* Every closure is live and distinct.  */
+      for (t = 0; t < THREADS; t++)
+	for (i = 0; i < CLOSURES; i++)
+	  CHECK(((int (*)(int)) code[t][i]) (-1) == tag (r, t, i) - 1);
+    }
+
+  /* Free the rest from a thread that made none of them.  */
+  for (t = 0; t < THREADS; t++)
+    for (i = 0; i < CLOSURES; i++)
+      ffi_closure_free (cl[t][i]);
+
+  /* As with free, a null pointer is ignored.  */
+  ffi_closure_free (NULL);
+  exit(0);
+}
+
+#else
+int main (void) { exit(0); }
+#endif
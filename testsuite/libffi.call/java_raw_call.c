@@ -0,0 +1,200 @@
+/* Area:	ffi_java_raw_call, ffi_prep_java_raw_closure_loc
+   Purpose:	Check Java raw calls and closures, where 64-bit values
+		take two slots.
+   Limitations:	none.
+   PR:		none.
+   Originator:	none.  */
+
+/* { dg-do run } */
+#include "ffitest.h"
+
+#if FFI_SIZEOF_JAVA_RAW == 8
+
+static long long
+mix (int i0, long long j0, double d0, float f0, short s0, void *p,
+     long long j1, int i1, double d1, long long j2, signed char b,
+     long long j3, float f1)
+{
+  return i0 + j0 + (long long) d0 + (long long) f0 + s0
+    + (p != NULL) + j1 + i1 + (long long) d1 + j2 + b + j3
+    + (long long) (f1 * 4);
+}
+
+#define NARGS 13
+
+/* More arguments than the x86-64 plan records.  */
+#define MANY 17
+
+static long long
+many (int a0, int a1, int a2, int a3, int a4, int a5, int a6, int a7,
+      int a8, int a9, int a10, int a11, int a12, int a13, int a14,
+      int a15, long long a16)
+{
+  return a0 + 2 * a1 + 3 * a2 + 4 * a3 + 5 * a4 + 6 * a5 + 7 * a6
+    + 8 * a7 + 9 * a8 + 10 * a9 + 11 * a10 + 12 * a11 + 13 * a12
+    + 14 * a13 + 15 * a14 + 16 * a15 + 17 * a16;
+}
+
+static void
+many_java (ffi_cif *cif, void *ret, ffi_java_raw *raw, void *user_data)
+{
+  long long sum = 0;
+  unsigned int j;
+
+  CHECK(user_data == (void *) many);
+  CHECK(cif->nargs == MANY);
+  for (j = 0; j < MANY - 1; j++)
+    sum += (j + 1) * (int) raw[j].sint;
+  sum += MANY * *(long long *) &raw[MANY - 1];
+  *(long long *) ret = sum;
+}
+
+#if defined (__x86_64__) && defined (__GNUC__)
+static long long __MSABI__
+ms_sub3 (int a, long long b, int c)
+{
+  return a - b - c;
+}
+
+static void
+sub3_java (ffi_cif *cif __UNUSED__, void *ret, ffi_java_raw *raw,
+	   void *user_data)
+{
+  CHECK(user_data == (void *) ms_sub3);
+  *(long long *) ret
+    = (int) raw[0].sint - *(long long *) &raw[1] - (int) raw[3].sint;
+}
+#endif
+
+static void
+mix_java (ffi_cif *cif, void *ret, ffi_java_raw *raw, void *user_data)
+{
+  CHECK(user_data == (void *) mix);
+  CHECK(cif->nargs == NARGS);
+
+  /* 64-bit values are followed by an empty slot.  */
+  *(long long *) ret
+    = mix ((int) raw[0].sint, *(long long *) &raw[1],
+	   *(double *) &raw[3], raw[5].flt, (short) raw[6].sint,
+	   raw[7].ptr, *(long long *) &raw[8], (int) raw[10].sint,
+	   *(double *) &raw[11], *(long long *) &raw[13],
+	   (signed char) raw[15].sint, *(long long *) &raw[16],
+	   raw[18].flt);
+}
+
+int main (void)
+{
+  ffi_cif cif;
+  ffi_type *args[MANY];
+  void *avalue[NARGS];
+  ffi_java_raw *raw;
+  ffi_java_raw_closure *closure;
+  void *code;
+  long long (*fn)(int, long long, double, float, short, void *, long long,
+		  int, double, long long, signed char, long long, float);
+  int i0 = -3, i1 = 7;
+  long long j0 = 1LL << 40, j1 = -20, j2 = 300, j3 = -(1LL << 33);
+  double d0 = 2.5, d1 = 1000.75;
+  float f0 = 9.5f, f1 = 0.75f;
+  short s0 = -1000;
+  signed char b = -100;
+  void *p = &i0;
+  long long res, expect;
+  int j;
+
+  args[0] = &ffi_type_sint;
+  args[1] = &ffi_type_sint64;
+  args[2] = &ffi_type_double;
+  args[3] = &ffi_type_float;
+  args[4] = &ffi_type_sshort;
+  args[5] = &ffi_type_pointer;
+  args[6] = &ffi_type_sint64;
+  args[7] = &ffi_type_sint;
+  args[8] = &ffi_type_double;
+  args[9] = &ffi_type_sint64;
+  args[10] = &ffi_type_schar;
+  args[11] = &ffi_type_sint64;
+  args[12] = &ffi_type_float;
+  CHECK(ffi_prep_cif(&cif, FFI_DEFAULT_ABI, NARGS, &ffi_type_sint64, args)
+	== FFI_OK);
+
+  avalue[0] = &i0;
+  avalue[1] = &j0;
+  avalue[2] = &d0;
+  avalue[3] = &f0;
+  avalue[4] = &s0;
+  avalue[5] = &p;
+  avalue[6] = &j1;
+  avalue[7] = &i1;
+  avalue[8] = &d1;
+  avalue[9] = &j2;
+  avalue[10] = &b;
+  avalue[11] = &j3;
+  avalue[12] = &f1;
+
+  expect = mix (i0, j0, d0, f0, s0, p, j1, i1, d1, j2, b, j3, f1);
+  CHECK(ffi_java_raw_size (&cif) == 19 * sizeof (ffi_java_raw));
+  raw = malloc (ffi_java_raw_size (&cif));
+  ffi_java_ptrarray_to_raw (&cif, avalue, raw);
+
+  res = 0;
+  ffi_java_raw_call (&cif, FFI_FN(mix), &res, raw);
+  printf ("%lld %lld\n", res, expect);
+  CHECK(res == expect);
+
+  closure = ffi_closure_alloc (sizeof (ffi_java_raw_closure), &code);
+  CHECK(closure != NULL);
+  CHECK(ffi_prep_java_raw_closure_loc (closure, &cif, mix_java,
+				       (void *) mix, code) == FFI_OK);
+
+  fn = code;
+  res = fn (i0, j0, d0, f0, s0, p, j1, i1, d1, j2, b, j3, f1);
+  CHECK(res == expect);
+
+  /* A Java raw call to a Java raw closure.  */
+  res = 0;
+  ffi_java_raw_call (&cif, FFI_FN(code), &res, raw);
+  CHECK(res == expect);
+
+  ffi_closure_free (closure);
+
+  /* Too many arguments for the plan, so the closure goes through the
+     generic translation.  */
+  for (j = 0; j < MANY - 1; j++)
+    args[j] = &ffi_type_sint;
+  args[MANY - 1] = &ffi_type_sint64;
+  CHECK(ffi_prep_cif(&cif, FFI_DEFAULT_ABI, MANY, &ffi_type_sint64, args)
+	== FFI_OK);
+  closure = ffi_closure_alloc (sizeof (ffi_java_raw_closure), &code);
+  CHECK(closure != NULL);
+  CHECK(ffi_prep_java_raw_closure_loc (closure, &cif, many_java,
+				       (void *) many, code) == FFI_OK);
+  CHECK(((long long (*)(int, int, int, int, int, int, int, int, int, int,
+			int, int, int, int, int, int, long long)) code)
+	(1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 1LL << 40)
+	== many (1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16,
+		 1LL << 40));
+  ffi_closure_free (closure);
+
+#if defined (__x86_64__) && defined (__GNUC__)
+  /* Another ABI.  */
+  args[0] = &ffi_type_sint;
+  args[1] = &ffi_type_sint64;
+  args[2] = &ffi_type_sint;
+  CHECK(ffi_prep_cif(&cif, FFI_GNUW64, 3, &ffi_type_sint64, args) == FFI_OK);
+  closure = ffi_closure_alloc (sizeof (ffi_java_raw_closure), &code);
+  CHECK(closure != NULL);
+  CHECK(ffi_prep_java_raw_closure_loc (closure, &cif, sub3_java,
+				       (void *) ms_sub3, code) == FFI_OK);
+  CHECK(((long long (__MSABI__ *)(int, long long, int)) code)
+	(100, 1LL << 33, 3) == 97 - (1LL << 33));
+  ffi_closure_free (closure);
+#endif
+
+  free (raw);
+  exit(0);
+}
+
+#else
+int main (void) { exit(0); }
+#endif
@@ -0,0 +1,69 @@
+/* Area:	ffi_call
+   Purpose:	Check calls whose interleaved scalar arguments fill every
+		argument register.
+   Limitations:	none.
+   PR:		none.
+   Originator:	none.  */
+
+/* { dg-do run } */
+#include "ffitest.h"
+
+static double ABI_ATTR
+interleaved (signed char a, float b, unsigned short c, double d, int e,
+	     float f, long long g, double h, void *i, float j, double k,
+	     unsigned char l, float m, double n)
+{
+  return a + b + c + d + e + f + g + h + (i != NULL) + j + k + l + m + n;
+}
+
+static unsigned char ABI_ATTR
+narrow (float x, int y)
+{
+  return (unsigned char) (x + y);
+}
+
+int main (void)
+{
+  ffi_cif cif;
+  ffi_type *args[MAX_ARGS];
+  void *values[MAX_ARGS];
+  signed char a = -1;
+  float b = 2.5f, f = -4.0f, j = 0.25f, m = 8.0f;
+  unsigned short c = 60000;
+  double d = 1e10, h = -1e10, k = 0.5, n = 3.0;
+  int e = -77;
+  long long g = 1LL << 40;
+  void *i = &cif;
+  unsigned char l = 200;
+  double r;
+  ffi_arg rc;
+  int y = 250;
+
+  args[0] = &ffi_type_schar;	values[0] = &a;
+  args[1] = &ffi_type_float;	values[1] = &b;
+  args[2] = &ffi_type_ushort;	values[2] = &c;
+  args[3] = &ffi_type_double;	values[3] = &d;
+  args[4] = &ffi_type_sint;	values[4] = &e;
+  args[5] = &ffi_type_float;	values[5] = &f;
+  args[6] = &ffi_type_sint64;	values[6] = &g;
+  args[7] = &ffi_type_double;	values[7] = &h;
+  args[8] = &ffi_type_pointer;	values[8] = &i;
+  args[9] = &ffi_type_float;	values[9] = &j;
+  args[10] = &ffi_type_double;	values[10] = &k;
+  args[11] = &ffi_type_uchar;	values[11] = &l;
+  args[12] = &ffi_type_float;	values[12] = &m;
+  args[13] = &ffi_type_double;	values[13] = &n;
+
+  CHECK(ffi_prep_cif(&cif, ABI_NUM, 14, &ffi_type_double, args) == FFI_OK);
+  ffi_call(&cif, FFI_FN(interleaved), &r, values);
+  CHECK(r == interleaved (a, b, c, d, e, f, g, h, i, j, k, l, m, n));
+
+  args[0] = &ffi_type_float;	values[0] = &b;
+  args[1] = &ffi_type_sint;	values[1] = &y;
+  CHECK(ffi_prep_cif(&cif, ABI_NUM, 2, &ffi_type_uchar, args) == FFI_OK);
+  rc = ~(ffi_arg) 0;
+  ffi_call(&cif, FFI_FN(narrow), &rc, values);
+  CHECK(rc == 252);
+
+  exit(0);
+}
@@ -0,0 +1,250 @@
+/* Area:	ffi_raw_call, ffi_prep_raw_closure_loc
+   Purpose:	Check raw calls and closures with register and stack
+		arguments.
+   Limitations:	none.
+   PR:		none.
+   Originator:	none.  */
+
+/* { dg-do run } */
+#include "ffitest.h"
+
+typedef struct { double x; long y; } mix;
+typedef struct { long a, b, c; } big;
+
+static big
+combine (signed char c, double d0, mix s, float f, long l0, long l1,
+	 long l2, long l3, long l4, double d1, double d2, double d3,
+	 double d4, double d5, double d6, unsigned short u)
+{
+  big r;
+
+  r.a = c + l0 + l1 + l2 + l3 + l4 + s.y + u;
+  r.b = (long) (d0 + d1 + d2 + d3 + d4 + d5 + d6 + s.x + f);
+  r.c = c * 1000 + u;
+  return r;
+}
+
+static int
+sum_ptr (int a, int *p, unsigned char b)
+{
+  return a + *p + b;
+}
+
+#define NARGS 16
+
+/* More arguments than the x86-64 plan records.  */
+#define MANY 17
+
+static long
+many (long a0, long a1, long a2, long a3, long a4, long a5, long a6,
+      long a7, long a8, long a9, long a10, long a11, long a12, long a13,
+      long a14, long a15, long a16)
+{
+  return a0 + 2 * a1 + 3 * a2 + 4 * a3 + 5 * a4 + 6 * a5 + 7 * a6
+    + 8 * a7 + 9 * a8 + 10 * a9 + 11 * a10 + 12 * a11 + 13 * a12
+    + 14 * a13 + 15 * a14 + 16 * a15 + 17 * a16;
+}
+
+static void
+combine_raw (ffi_cif *cif, void *ret, ffi_raw *raw, void *user_data)
+{
+  void *avalue[NARGS];
+
+  CHECK(user_data == (void *) combine);
+  CHECK(cif->nargs == NARGS);
+  ffi_raw_to_ptrarray (cif, raw, avalue);
+  *(big *) ret
+    = combine (*(signed char *) avalue[0], *(double *) avalue[1],
+	       *(mix *) avalue[2], *(float *) avalue[3],
+	       *(long *) avalue[4], *(long *) avalue[5],
+	       *(long *) avalue[6], *(long *) avalue[7],
+	       *(long *) avalue[8], *(double *) avalue[9],
+	       *(double *) avalue[10], *(double *) avalue[11],
+	       *(double *) avalue[12], *(double *) avalue[13],
+	       *(double *) avalue[14], *(unsigned short *) avalue[15]);
+}
+
+static void
+sum_ptr_raw (ffi_cif *cif __UNUSED__, void *ret, ffi_raw *raw,
+	     void *user_data __UNUSED__)
+{
+  /* Arguments smaller than a slot are extended.  */
+  CHECK(raw[0].sint == -5);
+  CHECK(raw[2].uint == 200);
+  *(ffi_arg *) ret = sum_ptr ((int) raw[0].sint, raw[1].ptr,
+			      (unsigned char) raw[2].uint);
+}
+
+static void
+many_raw (ffi_cif *cif, void *ret, ffi_raw *raw, void *user_data)
+{
+  long sum = 0;
+  unsigned int j;
+
+  CHECK(user_data == (void *) many);
+  CHECK(cif->nargs == MANY);
+  for (j = 0; j < MANY; j++)
+    sum += (j + 1) * (long) raw[j].sint;
+  *(ffi_arg *) ret = sum;
+}
+
+#if defined (__x86_64__) && defined (__GNUC__)
+static long __MSABI__
+ms_sub3 (long a, long b, long c)
+{
+  return a - b - c;
+}
+
+static void
+sub3_raw (ffi_cif *cif __UNUSED__, void *ret, ffi_raw *raw,
+	  void *user_data)
+{
+  CHECK(user_data == (void *) ms_sub3);
+  *(ffi_arg *) ret = raw[0].sint - raw[1].sint - raw[2].sint;
+}
+#endif
+
+int main (void)
+{
+  ffi_cif cif;
+  ffi_type *args[MANY];
+  ffi_type mix_type, big_type;
+  ffi_type *mix_elements[3], *big_elements[4];
+  void *avalue[NARGS];
+  ffi_raw *raw;
+  ffi_raw_closure *closure;
+  void *code;
+  big (*fn)(signed char, double, mix, float, long, long, long, long, long,
+	    double, double, double, double, double, double, unsigned short);
+  int (*fn2)(int, int *, unsigned char);
+  signed char c = -7;
+  double d[7] = { 0.5, 1, 2, 3, 4, 5, 6 };
+  mix s = { 10.25, 100 };
+  float f = 0.25f;
+  long l[5] = { 1, 2, 3, 4, 5 };
+  unsigned short u = 60000;
+  int a = -5, i = 40;
+  int *p = &i;
+  unsigned char b = 200;
+  ffi_arg res;
+  big r;
+  int j;
+
+  mix_type.size = mix_type.alignment = 0;
+  mix_type.type = FFI_TYPE_STRUCT;
+  mix_type.elements = mix_elements;
+  mix_elements[0] = &ffi_type_double;
+  mix_elements[1] = &ffi_type_slong;
+  mix_elements[2] = NULL;
+
+  big_type.size = big_type.alignment = 0;
+  big_type.type = FFI_TYPE_STRUCT;
+  big_type.elements = big_elements;
+  for (j = 0; j < 3; j++)
+    big_elements[j] = &ffi_type_slong;
+  big_elements[3] = NULL;
+
+  args[0] = &ffi_type_schar;
+  args[1] = &ffi_type_double;
+  args[2] = &mix_type;
+  args[3] = &ffi_type_float;
+  for (j = 0; j < 5; j++)
+    args[4 + j] = &ffi_type_slong;
+  for (j = 0; j < 6; j++)
+    args[9 + j] = &ffi_type_double;
+  args[15] = &ffi_type_ushort;
+  CHECK(ffi_prep_cif(&cif, FFI_DEFAULT_ABI, NARGS, &big_type, args) == FFI_OK);
+
+  avalue[0] = &c;
+  avalue[1] = &d[0];
+  avalue[2] = &s;
+  avalue[3] = &f;
+  for (j = 0; j < 5; j++)
+    avalue[4 + j] = &l[j];
+  for (j = 0; j < 6; j++)
+    avalue[9 + j] = &d[1 + j];
+  avalue[15] = &u;
+
+  raw = malloc (ffi_raw_size (&cif));
+  ffi_ptrarray_to_raw (&cif, avalue, raw);
+
+  memset (&r, 0, sizeof (r));
+  ffi_raw_call (&cif, FFI_FN(combine), &r, raw);
+  printf ("%ld %ld %ld\n", r.a, r.b, r.c);
+  CHECK(r.a == -7 + 15 + 100 + 60000);
+  CHECK(r.b == 32);
+  CHECK(r.c == -7000 + 60000);
+
+  closure = ffi_closure_alloc (sizeof (ffi_raw_closure), &code);
+  CHECK(closure != NULL);
+  CHECK(ffi_prep_raw_closure_loc (closure, &cif, combine_raw,
+				  (void *) combine, code) == FFI_OK);
+
+  fn = code;
+  memset (&r, 0, sizeof (r));
+  r = fn (c, d[0], s, f, l[0], l[1], l[2], l[3], l[4], d[1], d[2], d[3],
+	  d[4], d[5], d[6], u);
+  CHECK(r.a == -7 + 15 + 100 + 60000);
+  CHECK(r.b == 32);
+  CHECK(r.c == -7000 + 60000);
+
+  /* A raw call to a raw closure.  */
+  memset (&r, 0, sizeof (r));
+  ffi_raw_call (&cif, FFI_FN(code), &r, raw);
+  CHECK(r.a == -7 + 15 + 100 + 60000);
+  CHECK(r.c == -7000 + 60000);
+  ffi_closure_free (closure);
+
+  /* Only general registers.  */
+  args[0] = &ffi_type_sint;
+  args[1] = &ffi_type_pointer;
+  args[2] = &ffi_type_uchar;
+  CHECK(ffi_prep_cif(&cif, FFI_DEFAULT_ABI, 3, &ffi_type_sint, args) == FFI_OK);
+
+  avalue[0] = &a;
+  avalue[1] = &p;
+  avalue[2] = &b;
+  ffi_ptrarray_to_raw (&cif, avalue, raw);
+
+  res = 0;
+  ffi_raw_call (&cif, FFI_FN(sum_ptr), &res, raw);
+  CHECK((int) res == 235);
+
+  closure = ffi_closure_alloc (sizeof (ffi_raw_closure), &code);
+  CHECK(closure != NULL);
+  CHECK(ffi_prep_raw_closure_loc (closure, &cif, sum_ptr_raw, NULL, code)
+	== FFI_OK);
+  fn2 = code;
+  CHECK(fn2 (a, p, b) == 235);
+  ffi_closure_free (closure);
+
+  /* Too many arguments for the plan, so the closure goes through the
+     generic translation.  */
+  for (j = 0; j < MANY; j++)
+    args[j] = &ffi_type_slong;
+  CHECK(ffi_prep_cif(&cif, FFI_DEFAULT_ABI, MANY, &ffi_type_slong, args)
+	== FFI_OK);
+  closure = ffi_closure_alloc (sizeof (ffi_raw_closure), &code);
+  CHECK(closure != NULL);
+  CHECK(ffi_prep_raw_closure_loc (closure, &cif, many_raw, (void *) many,
+				  code) == FFI_OK);
+  CHECK(((long (*)(long, long, long, long, long, long, long, long, long,
+		   long, long, long, long, long, long, long, long)) code)
+	(1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17)
+	== many (1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17));
+  ffi_closure_free (closure);
+
+#if defined (__x86_64__) && defined (__GNUC__)
+  /* Another ABI.  */
+  CHECK(ffi_prep_cif(&cif, FFI_GNUW64, 3, &ffi_type_slong, args) == FFI_OK);
+  closure = ffi_closure_alloc (sizeof (ffi_raw_closure), &code);
+  CHECK(closure != NULL);
+  CHECK(ffi_prep_raw_closure_loc (closure, &cif, sub3_raw, (void *) ms_sub3,
+				  code) == FFI_OK);
+  CHECK(((long (__MSABI__ *)(long, long, long)) code) (100, 20, 3) == 77);
+  ffi_closure_free (closure);
+#endif
+
+  free (raw);
+  exit(0);
+}
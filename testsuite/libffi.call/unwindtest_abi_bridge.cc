@@ -0,0 +1,82 @@
+/* Area:	ffi_prep_abi_bridge, unwind info
+   Purpose:	Check that exceptions propagate through ABI bridges in
+		both directions.
+   Limitations:	none.
+   PR:		none.
+   Originator:	none.  */
+
+/* { dg-do run } */
+
+#include "ffitest.h"
+
+#if FFI_CALL_STUBS
+
+static int checking (int a, short b, signed char c)
+{
+  throw a + b + c;
+}
+
+static int __MSABI__ ms_checking (int a, short b, signed char c)
+{
+  throw a + b + c;
+}
+
+typedef int (*checking_fn) (int, short, signed char);
+typedef int (__MSABI__ *ms_checking_fn) (int, short, signed char);
+
+int main (void)
+{
+  ffi_cif cif, ms_cif;
+  ffi_type *args[3];
+  void *to_sysv, *to_ms;
+  int caught;
+
+  args[0] = &ffi_type_sint;
+  args[1] = &ffi_type_sshort;
+  args[2] = &ffi_type_schar;
+  CHECK(ffi_prep_cif(&cif, FFI_UNIX64, 3, &ffi_type_sint, args) == FFI_OK);
+  CHECK(ffi_prep_cif(&ms_cif, FFI_WIN64, 3, &ffi_type_sint, args) == FFI_OK);
+
+  /* A Microsoft x64 caller of a SysV function.  */
+  to_sysv = ffi_prep_abi_bridge (&cif, FFI_FN(checking));
+  CHECK(to_sysv != NULL);
+  caught = 0;
+  try
+    {
+      ((ms_checking_fn) to_sysv) (-6, -12, -1);
+    }
+  catch (int exception_code)
+    {
+      CHECK(exception_code == -19);
+      caught = 1;
+    }
+  CHECK(caught);
+  ffi_abi_bridge_free (to_sysv);
+
+  /* A SysV caller of a Microsoft x64 function.  */
+  to_ms = ffi_prep_abi_bridge (&ms_cif, FFI_FN(ms_checking));
+  CHECK(to_ms != NULL);
+  caught = 0;
+  try
+    {
+      ((checking_fn) to_ms) (-6, -12, -1);
+    }
+  catch (int exception_code)
+    {
+      CHECK(exception_code == -19);
+      caught = 1;
+    }
+  CHECK(caught);
+  ffi_abi_bridge_free (to_ms);
+
+  exit(0);
+}
+
+#else
+
+int main (void)
+{
+  exit(0);
+}
+
+#endif
@@ -0,0 +1,91 @@
+/* Area:	ffi_prep_bound_closure, unwind info
+   Purpose:	Check that exceptions propagate through bound closures,
+		including those that pass arguments on the stack.
+   Limitations:	none.
+   PR:		none.
+   Originator:	none.  */
+
+/* { dg-do run } */
+
+#include "ffitest.h"
+
+#if FFI_CALL_STUBS
+
+static int checking (long k, int a, short b, signed char c)
+{
+  throw k + a + b + c;
+}
+
+static int many (long k, long a, long b, long c, long d, long e, long f,
+		 long g)
+{
+  throw k + a + b + c + d + e + f + g;
+}
+
+typedef int (*checking_fn) (int, short, signed char);
+typedef int (*many_fn) (long, long, long, long, long, long, long);
+
+int main (void)
+{
+  ffi_cif cif, many_cif;
+  ffi_type *args[4], *many_args[8];
+  void *values[1], *bound;
+  long k = 100;
+  int caught, i;
+
+  values[0] = &k;
+
+  /* Arguments only in registers, so the closure jumps to the
+     function.  */
+  args[0] = &ffi_type_slong;
+  args[1] = &ffi_type_sint;
+  args[2] = &ffi_type_sshort;
+  args[3] = &ffi_type_schar;
+  CHECK(ffi_prep_cif(&cif, FFI_DEFAULT_ABI, 4, &ffi_type_sint, args) == FFI_OK);
+  bound = ffi_prep_bound_closure (&cif, FFI_FN(checking), 1, values);
+  CHECK(bound != NULL);
+  caught = 0;
+  try
+    {
+      ((checking_fn) bound) (-6, -12, -1);
+    }
+  catch (long exception_code)
+    {
+      CHECK(exception_code == 81);
+      caught = 1;
+    }
+  CHECK(caught);
+  ffi_bound_closure_free (bound);
+
+  /* The last argument goes on the stack, so the closure has a frame
+     of its own.  */
+  for (i = 0; i < 8; i++)
+    many_args[i] = &ffi_type_slong;
+  CHECK(ffi_prep_cif(&many_cif, FFI_DEFAULT_ABI, 8, &ffi_type_sint,
+		     many_args) == FFI_OK);
+  bound = ffi_prep_bound_closure (&many_cif, FFI_FN(many), 1, values);
+  CHECK(bound != NULL);
+  caught = 0;
+  try
+    {
+      ((many_fn) bound) (1, 2, 3, 4, 5, 6, 7);
+    }
+  catch (long exception_code)
+    {
+      CHECK(exception_code == 128);
+      caught = 1;
+    }
+  CHECK(caught);
+  ffi_bound_closure_free (bound);
+
+  exit(0);
+}
+
+#else
+
+int main (void)
+{
+  exit(0);
+}
+
+#endif
@@ -0,0 +1,81 @@
+/* Area:	ffi_prep_call_stub, ffi_call, unwind info
+   Purpose:	Check that exceptions propagate through call stubs, and
+		through ffi_call once a cif is switched to one.
+   Limitations:	none.
+   PR:		none.
+   Originator:	none.  */
+
+/* { dg-do run } */
+
+#include "ffitest.h"
+
+/* More than the number of calls after which a tiered cif switches.  */
+#define CALLS 1500
+
+static int checking(int a, short b, signed char c)
+{
+  throw a + b + c;
+}
+
+int main (void)
+{
+  ffi_cif cif;
+  ffi_type *args[MAX_ARGS];
+  void *values[MAX_ARGS];
+  ffi_arg rint;
+  int i, caught;
+
+  signed int si;
+  signed short ss;
+  signed char sc;
+
+  args[0] = &ffi_type_sint;
+  values[0] = &si;
+  args[1] = &ffi_type_sshort;
+  values[1] = &ss;
+  args[2] = &ffi_type_schar;
+  values[2] = &sc;
+
+  CHECK(ffi_prep_cif(&cif, FFI_DEFAULT_ABI, 3,
+		     &ffi_type_sint, args) == FFI_OK);
+
+  si = -6;
+  ss = -12;
+  sc = -1;
+
+#if FFI_CALL_STUBS
+  {
+    ffi_call_stub stub = ffi_prep_call_stub (&cif, FFI_FN(checking));
+
+    CHECK(stub != NULL);
+    caught = 0;
+    try
+      {
+	stub (NULL, &rint, values);
+      }
+    catch (int exception_code)
+      {
+	CHECK(exception_code == -19);
+	caught = 1;
+      }
+    CHECK(caught);
+    ffi_call_stub_free (stub);
+  }
+#endif
+
+  for (i = 0; i < CALLS; i++)
+    {
+      caught = 0;
+      try
+	{
+	  ffi_call(&cif, FFI_FN(checking), &rint, values);
+	}
+      catch (int exception_code)
+	{
+	  CHECK(exception_code == -19);
+	  caught = 1;
+	}
+      CHECK(caught);
+    }
+  exit(0);
+}
@@ -0,0 +1,131 @@
+/* Area:	ffi_var_cif_alloc, ffi_var_cif_get
+   Purpose:	Check cifs derived from a variadic prefix.
+   Limitations:	none.
+   PR:		none.
+   Originator:	none.  */
+
+/* { dg-do run } */
+#include "ffitest.h"
+#include <stdarg.h>
+
+/* Sum the variadic arguments, whose types are given by FMT: 'i' for
+   int, 'l' for long, 'd' for double.  */
+static double
+sum (const char *fmt, int scale, ...)
+{
+  va_list ap;
+  double r = 0;
+
+  va_start (ap, scale);
+  for (; *fmt; fmt++)
+    switch (*fmt)
+      {
+      case 'i':
+	r += va_arg (ap, int);
+	break;
+      case 'l':
+	r += va_arg (ap, long);
+	break;
+      case 'd':
+	r += va_arg (ap, double);
+	break;
+      }
+  va_end (ap);
+  return r * scale;
+}
+
+int main (void)
+{
+  ffi_var_cif *vc;
+  ffi_cif *cif, *cif_il, *cif_d;
+  ffi_type *fixed[2], *tail[MAX_ARGS];
+  void *values[MAX_ARGS];
+  const char *fmt;
+  int scale = 2, i1 = 3, i2 = -4;
+  long l1 = 100000;
+  double d1 = 0.25, r;
+  int i;
+
+  fixed[0] = &ffi_type_pointer;
+  fixed[1] = &ffi_type_sint;
+  vc = ffi_var_cif_alloc (FFI_DEFAULT_ABI, 2, &ffi_type_double, fixed);
+  CHECK(vc != NULL);
+
+  /* The caller's array of fixed types need not be kept.  */
+  fixed[0] = fixed[1] = NULL;
+
+  values[0] = &fmt;
+  values[1] = &scale;
+
+  tail[0] = &ffi_type_sint;
+  tail[1] = &ffi_type_slong;
+  cif_il = ffi_var_cif_get (vc, 2, tail);
+  CHECK(cif_il != NULL);
+  CHECK(cif_il->nargs == 4);
+  fmt = "il";
+  values[2] = &i1;
+  values[3] = &l1;
+  ffi_call (cif_il, FFI_FN(sum), &r, values);
+  CHECK(r == 2 * (3 + 100000));
+
+  tail[0] = &ffi_type_double;
+  cif_d = ffi_var_cif_get (vc, 1, tail);
+  CHECK(cif_d != NULL && cif_d != cif_il);
+  fmt = "d";
+  values[2] = &d1;
+  ffi_call (cif_d, FFI_FN(sum), &r, values);
+  CHECK(r == 0.5);
+
+  /* No variadic arguments.  */
+  cif = ffi_var_cif_get (vc, 0, NULL);
+  CHECK(cif != NULL && cif->nargs == 2);
+  fmt = "";
+  ffi_call (cif, FFI_FN(sum), &r, values);
+  CHECK(r == 0);
+
+  /* The same tail yields the same cif.  */
+  tail[0] = &ffi_type_sint;
+  tail[1] = &ffi_type_slong;
+  CHECK(ffi_var_cif_get (vc, 2, tail) == cif_il);
+  tail[0] = &ffi_type_double;
+  CHECK(ffi_var_cif_get (vc, 1, tail) == cif_d);
+
+  /* Enough tails to make the table grow.  */
+  for (i = 0; i < 40; i++)
+    {
+      int j, n = i % 8 + 1;
+      static char buf[16];
+      double expect = 0;
+
+      for (j = 0; j < n; j++)
+	{
+	  if ((i >> (j % 5)) & 1)
+	    {
+	      tail[j] = &ffi_type_double;
+	      buf[j] = 'd';
+	      values[2 + j] = &d1;
+	      expect += 0.25;
+	    }
+	  else
+	    {
+	      tail[j] = &ffi_type_sint;
+	      buf[j] = 'i';
+	      values[2 + j] = &i2;
+	      expect -= 4;
+	    }
+	}
+      buf[n] = 0;
+      fmt = buf;
+      cif = ffi_var_cif_get (vc, n, tail);
+      CHECK(cif != NULL);
+      ffi_call (cif, FFI_FN(sum), &r, values);
+      CHECK(r == 2 * expect);
+    }
+
+  tail[0] = &ffi_type_sint;
+  tail[1] = &ffi_type_slong;
+  CHECK(ffi_var_cif_get (vc, 2, tail) == cif_il);
+
+  ffi_var_cif_free (vc);
+  exit(0);
+}
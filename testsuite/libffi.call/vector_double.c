@@ -0,0 +1,106 @@
+/* Area:	ffi_call, ffi_prep_call_stub
+   Purpose:	Check SSE arguments passed after a 16-byte vector, which
+		takes a single xmm register.
+   Limitations:	x86-64 Unix only.
+   PR:		none.
+   Originator:	none.  */
+
+/* { dg-do run } */
+#include "ffitest.h"
+
+#if defined (__x86_64__) && !defined (_WIN32) \
+    && FFI_TYPE_EXT_VECTOR != FFI_TYPE_STRUCT
+
+typedef float float4 __attribute__ ((vector_size (16)));
+
+static double
+vec_double (float4 v, double d)
+{
+  return v[0] + 2 * v[1] + 3 * v[2] + 4 * v[3] + d;
+}
+
+static double
+mixed (double a, float4 v, float f, float4 w, double b)
+{
+  return a + v[0] + v[3] + 10 * f + 100 * (w[1] + w[2]) + 1000 * b;
+}
+
+int main (void)
+{
+  ffi_cif cif;
+  ffi_type *args[MAX_ARGS];
+  void *values[MAX_ARGS];
+  ffi_type float4_type;
+  ffi_type *float4_elements[5];
+  float4 v = { 1, 2, 3, 4 }, w = { 5, 6, 7, 8 };
+  double d = 480, a = 1, b = 5;
+  float f = 3;
+  double r;
+  int i;
+
+  float4_type.size = 16;
+  float4_type.alignment = 16;
+  float4_type.type = FFI_TYPE_EXT_VECTOR;
+  float4_type.elements = float4_elements;
+  for (i = 0; i < 4; i++)
+    float4_elements[i] = &ffi_type_float;
+  float4_elements[4] = NULL;
+
+  args[0] = &float4_type;
+  values[0] = &v;
+  args[1] = &ffi_type_double;
+  values[1] = &d;
+  CHECK(ffi_prep_cif(&cif, FFI_DEFAULT_ABI, 2, &ffi_type_double, args) == FFI_OK);
+
+  r = 0;
+  ffi_call(&cif, FFI_FN(vec_double), &r, values);
+  CHECK(r == vec_double (v, d));
+#if FFI_CALL_STUBS
+  {
+    ffi_call_stub stub = ffi_prep_call_stub (&cif, FFI_FN(vec_double));
+
+    CHECK(stub != NULL);
+    r = 0;
+    stub (NULL, &r, values);
+    CHECK(r == vec_double (v, d));
+    ffi_call_stub_free (stub);
+  }
+#endif
+
+  args[0] = &ffi_type_double;
+  values[0] = &a;
+  args[1] = &float4_type;
+  values[1] = &v;
+  args[2] = &ffi_type_float;
+  values[2] = &f;
+  args[3] = &float4_type;
+  values[3] = &w;
+  args[4] = &ffi_type_double;
+  values[4] = &b;
+  CHECK(ffi_prep_cif(&cif, FFI_DEFAULT_ABI, 5, &ffi_type_double, args) == FFI_OK);
+
+  r = 0;
+  ffi_call(&cif, FFI_FN(mixed), &r, values);
+  CHECK(r == mixed (a, v, f, w, b));
+#if FFI_CALL_STUBS
+  {
+    ffi_call_stub stub = ffi_prep_call_stub (&cif, FFI_FN(mixed));
+
+    CHECK(stub != NULL);
+    r = 0;
+    stub (NULL, &r, values);
+    CHECK(r == mixed (a, v, f, w, b));
+    ffi_call_stub_free (stub);
+  }
+#endif
+  exit(0);
+}
+
+#else
+
+int main (void)
+{
+  exit(0);
+}
+
+#endif